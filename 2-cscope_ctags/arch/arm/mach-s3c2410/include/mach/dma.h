@@ -48,6 +48,7 @@ enum dma_ch {
 	DMACH_UART2_SRC2,
 	DMACH_UART3,		/* s3c2443 has extra uart */
 	DMACH_UART3_SRC2,
+	DMACH_NAND,		/* s3c2440 nand data, software triggered */
 	DMACH_MAX,		/* the end entry */
 };
 
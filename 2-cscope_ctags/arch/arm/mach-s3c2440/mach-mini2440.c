@@ -360,6 +360,7 @@ static struct s3c24xx_mci_pdata mini2440_mmc_cfg = {
    .gpio_wprotect = S3C2410_GPH(8),
    .set_power     = NULL,
    .ocr_avail     = MMC_VDD_32_33|MMC_VDD_33_34,
+   .use_dma       = 1,
 };
 
 
@@ -356,6 +356,11 @@ static int s3c2410_dma_start(struct s3c2410_dma_chan *chan)
 	tmp = dma_rdreg(chan, S3C2410_DMA_DMASKTRIG);
 	tmp &= ~S3C2410_DMASKTRIG_STOP;
 	tmp |= S3C2410_DMASKTRIG_ON;
+
+	/* channels without a hardware request need a software trigger */
+	if (!(chan->dcon & S3C2410_DCON_HWTRIG))
+		tmp |= S3C2410_DMASKTRIG_SWTRIG;
+
 	dma_wrreg(chan, S3C2410_DMA_DMASKTRIG, tmp);
 
 	pr_debug("dma%d: %08lx to DMASKTRIG\n", chan->number, tmp);
@@ -1060,6 +1065,13 @@ int s3c2410_dma_config(unsigned int channel,
 		dcon |= S3C2410_DCON_HANDSHAKE;
 		dcon |= S3C2410_DCON_SYNC_HCLK;
 		break;
+
+	case DMACH_NAND:
+		/* no request line, so run the whole transfer from a single
+		 * software trigger */
+		dcon |= S3C2410_DCON_SYNC_HCLK;
+		dcon |= S3C2410_DCON_WHOLESERV;
+		break;
 	}
 
 	switch (xferunit) {
@@ -1080,7 +1092,8 @@ int s3c2410_dma_config(unsigned int channel,
 		return -EINVAL;
 	}
 
-	dcon |= S3C2410_DCON_HWTRIG;
+	if (chan->req_ch != DMACH_NAND)
+		dcon |= S3C2410_DCON_HWTRIG;
 	dcon |= S3C2410_DCON_INTREQ;
 
 	pr_debug("%s: dcon now %08x\n", __func__, dcon);
@@ -1123,6 +1136,7 @@ int s3c2410_dma_devconfig(int channel,
 	switch (chan->req_ch) {
 	case DMACH_XD0:
 	case DMACH_XD1:
+	case DMACH_NAND:
 		hwcfg = 0; /* AHB */
 		break;
 
@@ -1392,7 +1406,7 @@ static struct s3c2410_dma_chan *s3c2410_dma_map_channel(int channel)
 	struct s3c2410_dma_chan *dmach;
 	int ch;
 
-	if (dma_sel.map == NULL || channel > dma_sel.map_size)
+	if (dma_sel.map == NULL || channel >= dma_sel.map_size)
 		return NULL;
 
 	ch_map = dma_sel.map + channel;
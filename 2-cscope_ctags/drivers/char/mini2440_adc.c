@@ -9,6 +9,13 @@
 #include <linux/clk.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
+#include <linux/interrupt.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#include <linux/mutex.h>
+#include <linux/log2.h>
+#include <linux/dma-mapping.h>
+#include <linux/moduleparam.h>
 #include <asm/io.h>
 #include <asm/irq.h>
 #include <asm/uaccess.h>
@@ -38,8 +45,23 @@ typedef struct {
 	wait_queue_head_t wait;
 	int channel;
 	int prescale;
+
+	/* continuous sampling */
+	unsigned int rate;
+	struct kfifo *fifo;
+	spinlock_t fifo_lock;
+	unsigned char *ring;
+	dma_addr_t ring_dma;
+	struct mutex read_lock;
+	unsigned long overruns;
+	unsigned long missed;
+	int users;
 }ADC_DEV;
 
+static unsigned int ring_size = 16384;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size, "continuous sampling ring buffer size in bytes");
+
 DECLARE_MUTEX(ADC_LOCK);
 static int OwnADC = 0;
 
@@ -72,21 +94,216 @@ static struct clk	*adc_clock;
 
 static irqreturn_t adcdone_int_handler(int irq, void *dev_id)
 {
+	unsigned short sample;
+
 	if (OwnADC) {
 		adc_data = ADCDAT0 & 0x3ff;
 
-		ev_adc = 1;
+		if (adcdev.rate) {
+			/* single producer, the reader only moves fifo->out */
+			sample = adc_data;
+			if (__kfifo_put(adcdev.fifo, (unsigned char *)&sample, sizeof(sample)) != sizeof(sample))
+				adcdev.overruns++;
+
+			OwnADC = 0;
+			up(&ADC_LOCK);
+		} else {
+			ev_adc = 1;
+		}
 		wake_up_interruptible(&adcdev.wait);
 	}
 
 	return IRQ_HANDLED;
 }
 
+/*
+ * timer 3 tick: start one conversion, the sample is collected in
+ * adcdone_int_handler. the touch screen driver shares the ADC through
+ * ADC_LOCK, ticks that find it busy are counted and skipped.
+ */
+static irqreturn_t adc_tick_handler(int irq, void *dev_id)
+{
+	if (down_trylock(&ADC_LOCK) == 0) {
+		OwnADC = 1;
+		START_ADC_AIN(adcdev.channel, adcdev.prescale);
+	} else {
+		adcdev.missed++;
+	}
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * timer 3 shares prescaler 1 with the system tick on timer 4, so leave
+ * TCFG0 alone and pick the smallest divider that fits TCNTB3.
+ */
+static int ADC_Start_Timer(unsigned int rate)
+{
+	unsigned long flags;
+	unsigned long tcfg0, tcfg1, tcon;
+	unsigned long tin, tcnt;
+	struct clk *clk_p;
+	int div;
+
+	clk_p = clk_get(NULL, "pclk");
+	if (IS_ERR(clk_p))
+		return PTR_ERR(clk_p);
+
+	tcfg0 = __raw_readl(S3C2410_TCFG0);
+	tin = clk_get_rate(clk_p) / (((tcfg0 & S3C2410_TCFG_PRESCALER1_MASK) >> S3C2410_TCFG_PRESCALER1_SHIFT) + 1);
+	clk_put(clk_p);
+
+	for (div = 0; div < 4; div++) {
+		tcnt = (tin >> (div + 1)) / rate;
+		if (tcnt <= 0x10000)
+			break;
+	}
+	if (div == 4 || tcnt < 2)
+		return -EINVAL;
+
+	local_irq_save(flags);
+
+	tcfg1 = __raw_readl(S3C2410_TCFG1);
+	tcfg1 &= ~S3C2410_TCFG1_MUX3_MASK;
+	tcfg1 |= div << S3C2410_TCFG1_SHIFT(3);
+	__raw_writel(tcfg1, S3C2410_TCFG1);
+
+	__raw_writel(tcnt - 1, S3C2410_TCNTB(3));
+
+	tcon = __raw_readl(S3C2410_TCON);
+	tcon &= ~(S3C2410_TCON_T3START | S3C2410_TCON_T3INVERT);
+	tcon |= S3C2410_TCON_T3RELOAD | S3C2410_TCON_T3MANUALUPD;
+	__raw_writel(tcon, S3C2410_TCON);
+
+	tcon &= ~S3C2410_TCON_T3MANUALUPD;
+	tcon |= S3C2410_TCON_T3START;
+	__raw_writel(tcon, S3C2410_TCON);
+
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+static void ADC_Stop_Timer(void)
+{
+	unsigned long flags;
+	unsigned long tcon;
+
+	local_irq_save(flags);
+	tcon = __raw_readl(S3C2410_TCON);
+	tcon &= ~S3C2410_TCON_T3START;
+	__raw_writel(tcon, S3C2410_TCON);
+	local_irq_restore(flags);
+}
+
+/* called with read_lock held */
+static int adc_set_rate(unsigned int rate)
+{
+	int ret;
+
+	if (rate > ADC_MAX_RATE)
+		return -EINVAL;
+
+	if (adcdev.rate) {
+		ADC_Stop_Timer();
+		free_irq(IRQ_TIMER3, &adcdev);
+
+		/* a conversion still in flight releases ADC_LOCK when done */
+		down(&ADC_LOCK);
+		adcdev.rate = 0;
+		up(&ADC_LOCK);
+		wake_up_interruptible(&adcdev.wait);
+	}
+
+	if (rate == 0)
+		return 0;
+
+	kfifo_reset(adcdev.fifo);
+	adcdev.overruns = 0;
+	adcdev.missed = 0;
+	adcdev.rate = rate;
+
+	ret = request_irq(IRQ_TIMER3, adc_tick_handler, IRQF_DISABLED, "adc-tick", &adcdev);
+	if (ret) {
+		adcdev.rate = 0;
+		return ret;
+	}
+
+	ret = ADC_Start_Timer(rate);
+	if (ret) {
+		free_irq(IRQ_TIMER3, &adcdev);
+		adcdev.rate = 0;
+	}
+
+	return ret;
+}
+
+/* copy straight out of the ring, only the reader moves fifo->out */
+static ssize_t adc_fifo_to_user(char __user *buffer, size_t count)
+{
+	struct kfifo *fifo = adcdev.fifo;
+	unsigned int len, off, l;
+
+	len = min_t(unsigned int, count, kfifo_len(fifo));
+	len &= ~(sizeof(unsigned short) - 1);
+
+	off = fifo->out & (fifo->size - 1);
+	l = min(len, fifo->size - off);
+
+	if (copy_to_user(buffer, fifo->buffer + off, l))
+		return -EFAULT;
+	if (copy_to_user(buffer + l, fifo->buffer, len - l))
+		return -EFAULT;
+
+	smp_mb();
+	fifo->out += len;
+
+	return len;
+}
+
+static ssize_t adc_read_samples(struct file *filp, char __user *buffer, size_t count)
+{
+	ssize_t ret;
+
+	if (count < sizeof(unsigned short))
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&adcdev.read_lock))
+		return -ERESTARTSYS;
+
+	while (kfifo_len(adcdev.fifo) < sizeof(unsigned short)) {
+		if (!adcdev.rate) {
+			ret = 0;
+			goto out;
+		}
+		if (filp->f_flags & O_NONBLOCK) {
+			ret = -EAGAIN;
+			goto out;
+		}
+
+		mutex_unlock(&adcdev.read_lock);
+		if (wait_event_interruptible(adcdev.wait,
+				kfifo_len(adcdev.fifo) >= sizeof(unsigned short) || !adcdev.rate))
+			return -ERESTARTSYS;
+		if (mutex_lock_interruptible(&adcdev.read_lock))
+			return -ERESTARTSYS;
+	}
+
+	ret = adc_fifo_to_user(buffer, count);
+out:
+	mutex_unlock(&adcdev.read_lock);
+	return ret;
+}
+
 static ssize_t s3c2410_adc_read(struct file *filp, char *buffer, size_t count, loff_t *ppos)
 {
 	char str[20];
 	int value;
 	size_t len;
+
+	if (adcdev.rate)
+		return adc_read_samples(filp, buffer, count);
+
 	if (down_trylock(&ADC_LOCK) == 0) {
 		OwnADC = 1;
 		START_ADC_AIN(adcdev.channel, adcdev.prescale);
@@ -115,10 +332,12 @@ static ssize_t s3c2410_adc_read(struct file *filp, char *buffer, size_t count, l
 
 static int s3c2410_adc_open(struct inode *inode, struct file *filp)
 {
-	init_waitqueue_head(&(adcdev.wait));
-
-	adcdev.channel=0;
-	adcdev.prescale=0xff;
+	mutex_lock(&adcdev.read_lock);
+	if (adcdev.users++ == 0) {
+		adcdev.channel=0;
+		adcdev.prescale=0xff;
+	}
+	mutex_unlock(&adcdev.read_lock);
 
 	DPRINTK( "adc opened\n");
 	return 0;
@@ -126,16 +345,100 @@ static int s3c2410_adc_open(struct inode *inode, struct file *filp)
 
 static int s3c2410_adc_release(struct inode *inode, struct file *filp)
 {
+	mutex_lock(&adcdev.read_lock);
+	if (--adcdev.users == 0)
+		adc_set_rate(0);
+	mutex_unlock(&adcdev.read_lock);
+
 	DPRINTK( "adc closed\n");
 	return 0;
 }
 
+static unsigned int s3c2410_adc_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	/* one-shot reads always return a value */
+	if (!adcdev.rate)
+		return POLLIN | POLLRDNORM;
+
+	poll_wait(filp, &adcdev.wait, wait);
+	if (kfifo_len(adcdev.fifo) >= sizeof(unsigned short))
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
+static int s3c2410_adc_ioctl(struct inode *inode, struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct adc_ring_info info;
+	unsigned int len;
+	int ret = 0;
+
+	mutex_lock(&adcdev.read_lock);
+	switch (cmd) {
+	case ADC_SET_CHANNEL:
+		if (arg > 7)
+			ret = -EINVAL;
+		else
+			adcdev.channel = arg;
+		break;
+
+	case ADC_SET_RATE:
+		ret = adc_set_rate(arg);
+		break;
+
+	case ADC_GET_RING:
+		memset(&info, 0, sizeof(info));
+		info.size = adcdev.fifo->size;
+		info.in = adcdev.fifo->in;
+		info.out = adcdev.fifo->out;
+		info.rate = adcdev.rate;
+		info.overruns = adcdev.overruns;
+		info.missed = adcdev.missed;
+		if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+			ret = -EFAULT;
+		break;
+
+	case ADC_RING_CONSUME:
+		len = kfifo_len(adcdev.fifo);
+		if (arg > len) {
+			ret = -EINVAL;
+			break;
+		}
+		smp_mb();
+		adcdev.fifo->out += arg;
+		break;
+
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+	mutex_unlock(&adcdev.read_lock);
+
+	return ret;
+}
+
+static int s3c2410_adc_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff != 0 || size > PAGE_ALIGN(adcdev.fifo->size))
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	/* the ring is uncached, no cache maintenance on either side */
+	return dma_mmap_coherent(NULL, vma, adcdev.ring, adcdev.ring_dma, size);
+}
+
 
 static struct file_operations dev_fops = {
 	owner:	THIS_MODULE,
 	open:	s3c2410_adc_open,
 	read:	s3c2410_adc_read,	
 	release:	s3c2410_adc_release,
+	poll:	s3c2410_adc_poll,
+	ioctl:	s3c2410_adc_ioctl,
+	mmap:	s3c2410_adc_mmap,
 };
 
 static struct miscdevice misc = {
@@ -148,9 +451,28 @@ static int __init dev_init(void)
 {
 	int ret;
 
+	init_waitqueue_head(&(adcdev.wait));
+	mutex_init(&adcdev.read_lock);
+	spin_lock_init(&adcdev.fifo_lock);
+
+	/* the ring is mmap()able, keep it uncached and page sized */
+	ring_size = roundup_pow_of_two(max_t(unsigned int, ring_size, PAGE_SIZE));
+	adcdev.ring = dma_alloc_coherent(NULL, ring_size, &adcdev.ring_dma, GFP_KERNEL);
+	if (adcdev.ring == NULL) {
+		printk(KERN_ERR "Failed to allocate sample ring\n");
+		return -ENOMEM;
+	}
+	adcdev.fifo = kfifo_init(adcdev.ring, ring_size, GFP_KERNEL, &adcdev.fifo_lock);
+	if (IS_ERR(adcdev.fifo)) {
+		dma_free_coherent(NULL, ring_size, adcdev.ring, adcdev.ring_dma);
+		return PTR_ERR(adcdev.fifo);
+	}
+
 	base_addr=ioremap(S3C2410_PA_ADC,0x20);
 	if (base_addr == NULL) {
 		printk(KERN_ERR "Failed to remap register block\n");
+		kfree(adcdev.fifo);
+		dma_free_coherent(NULL, ring_size, adcdev.ring, adcdev.ring_dma);
 		return -ENOMEM;
 	}
 
@@ -181,6 +503,9 @@ static void __exit dev_exit(void)
 	free_irq(IRQ_ADC, &adcdev);
 	iounmap(base_addr);
 
+	kfree(adcdev.fifo);
+	dma_free_coherent(NULL, ring_size, adcdev.ring, adcdev.ring_dma);
+
 	if (adc_clock) {
 		clk_disable(adc_clock);
 		clk_put(adc_clock);
@@ -15,15 +15,44 @@
 #include <linux/miscdevice.h>
 #include <linux/sched.h>
 #include <linux/gpio.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/moduleparam.h>
+
+#include "mini2440_buttons.h"
 
 #define DEVICE_NAME     "buttons"
 
+/* events per open file, the oldest are overwritten when a reader lags */
+#define BUTTON_QUEUE_LEN	64
+
+static unsigned int debounce_ms = 20;
+module_param(debounce_ms, uint, 0644);
+MODULE_PARM_DESC(debounce_ms, "key debounce time in milliseconds");
+
 struct button_irq_desc {
     int irq;
     int pin;
     int pin_setting;
     int number;
     char *name;	
+
+    struct hrtimer timer;	/* debounce */
+    ktime_t edge;		/* first edge of the current bounce */
+    int down;			/* last reported state */
+};
+
+/* one per open file */
+struct button_client {
+    struct list_head list;
+    wait_queue_head_t wait;
+    int event_mode;
+    int changed;		/* snapshot mode: key_values changed */
+    unsigned int head, tail;
+    struct mini2440_button_event queue[BUTTON_QUEUE_LEN];
 };
 
 static struct button_irq_desc button_irqs [] = {
@@ -36,36 +65,78 @@ static struct button_irq_desc button_irqs [] = {
 };
 static volatile char key_values [] = {'0', '0', '0', '0', '0', '0'};
 
-static DECLARE_WAIT_QUEUE_HEAD(button_waitq);
+static LIST_HEAD(button_clients);
+static DEFINE_SPINLOCK(button_lock);	/* button_clients, the queues and key_values */
+static DEFINE_MUTEX(button_open_lock);
+static int button_users;
 
-static volatile int ev_press = 0;
 
+/* called with button_lock held */
+static void buttons_queue_event(struct button_client *client, struct mini2440_button_event *ev)
+{
+    client->queue[client->head % BUTTON_QUEUE_LEN] = *ev;
+    client->head++;
+    if (client->head - client->tail > BUTTON_QUEUE_LEN)
+	client->tail = client->head - BUTTON_QUEUE_LEN;
+}
 
-static irqreturn_t buttons_interrupt(int irq, void *dev_id)
+/*
+ * the key has been quiet for debounce_ms, report it if the level
+ * differs from what was reported last, stamped with the first edge.
+ */
+static enum hrtimer_restart buttons_debounce(struct hrtimer *timer)
 {
-    struct button_irq_desc *button_irqs = (struct button_irq_desc *)dev_id;
+    struct button_irq_desc *button_irqs = container_of(timer, struct button_irq_desc, timer);
+    struct mini2440_button_event ev;
+    struct button_client *client;
+    unsigned long flags;
     int down;
 
-    // udelay(0);
     down = !s3c2410_gpio_getpin(button_irqs->pin);
+    if (down == button_irqs->down)
+	return HRTIMER_NORESTART;
+
+    button_irqs->down = down;
+    ev.time = ktime_to_timespec(button_irqs->edge);
+    ev.code = button_irqs->number;
+    ev.value = down;
+
+    spin_lock_irqsave(&button_lock, flags);
+    key_values[button_irqs->number] = '0' + down;
+    list_for_each_entry(client, &button_clients, list) {
+	buttons_queue_event(client, &ev);
+	client->changed = 1;
+	wake_up_interruptible(&client->wait);
+    }
+    spin_unlock_irqrestore(&button_lock, flags);
 
-    if (down != (key_values[button_irqs->number] & 1)) { // Changed
+    return HRTIMER_NORESTART;
+}
+
+static irqreturn_t buttons_interrupt(int irq, void *dev_id)
+{
+    struct button_irq_desc *button_irqs = (struct button_irq_desc *)dev_id;
+
+    /* every bounce pushes the sample point out again */
+    if (!hrtimer_active(&button_irqs->timer))
+	button_irqs->edge = ktime_get();
+    hrtimer_start(&button_irqs->timer, ktime_set(0, debounce_ms * NSEC_PER_MSEC), HRTIMER_MODE_REL);
 
-	key_values[button_irqs->number] = '0' + down;
-	
-        ev_press = 1;
-        wake_up_interruptible(&button_waitq);
-    }
-    
     return IRQ_RETVAL(IRQ_HANDLED);
 }
 
 
-static int s3c24xx_buttons_open(struct inode *inode, struct file *file)
+static int buttons_request_irqs(void)
 {
     int i;
     int err = 0;
     
+    for (i = 0; i < sizeof(button_irqs)/sizeof(button_irqs[0]); i++) {
+	hrtimer_init(&button_irqs[i].timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	button_irqs[i].timer.function = buttons_debounce;
+	button_irqs[i].down = key_values[i] & 1;
+    }
+
     for (i = 0; i < sizeof(button_irqs)/sizeof(button_irqs[0]); i++) {
 	if (button_irqs[i].irq < 0) {
 		continue;
@@ -84,17 +155,15 @@ static int s3c24xx_buttons_open(struct inode *inode, struct file *file)
 	    }
 	    disable_irq(button_irqs[i].irq);
             free_irq(button_irqs[i].irq, (void *)&button_irqs[i]);
+	    hrtimer_cancel(&button_irqs[i].timer);
         }
         return -EBUSY;
     }
 
-    ev_press = 1;
-    
     return 0;
 }
 
-
-static int s3c24xx_buttons_close(struct inode *inode, struct file *file)
+static void buttons_free_irqs(void)
 {
     int i;
     
@@ -103,39 +172,149 @@ static int s3c24xx_buttons_close(struct inode *inode, struct file *file)
 	    continue;
 	}
 	free_irq(button_irqs[i].irq, (void *)&button_irqs[i]);
+	hrtimer_cancel(&button_irqs[i].timer);
+    }
+}
+
+
+static int s3c24xx_buttons_open(struct inode *inode, struct file *file)
+{
+    struct button_client *client;
+    unsigned long flags;
+    int err = 0;
+
+    client = kzalloc(sizeof(*client), GFP_KERNEL);
+    if (!client)
+	return -ENOMEM;
+    init_waitqueue_head(&client->wait);
+    client->changed = 1;
+
+    /* the IRQs are shared by all open files */
+    mutex_lock(&button_open_lock);
+    if (button_users == 0)
+	err = buttons_request_irqs();
+    if (!err)
+	button_users++;
+    mutex_unlock(&button_open_lock);
+
+    if (err) {
+	kfree(client);
+	return err;
     }
 
+    spin_lock_irqsave(&button_lock, flags);
+    list_add_tail(&client->list, &button_clients);
+    spin_unlock_irqrestore(&button_lock, flags);
+
+    file->private_data = client;
+    
+    return 0;
+}
+
+
+static int s3c24xx_buttons_close(struct inode *inode, struct file *file)
+{
+    struct button_client *client = file->private_data;
+    unsigned long flags;
+
+    spin_lock_irqsave(&button_lock, flags);
+    list_del(&client->list);
+    spin_unlock_irqrestore(&button_lock, flags);
+    kfree(client);
+
+    mutex_lock(&button_open_lock);
+    if (--button_users == 0)
+	buttons_free_irqs();
+    mutex_unlock(&button_open_lock);
+
     return 0;
 }
 
 
+static int buttons_ready(struct button_client *client)
+{
+    if (client->event_mode)
+	return client->head != client->tail;
+    return client->changed;
+}
+
 static int s3c24xx_buttons_read(struct file *filp, char __user *buff, size_t count, loff_t *offp)
 {
-    unsigned long err;
+    struct button_client *client = filp->private_data;
+    struct mini2440_button_event ev[8];
+    char values[sizeof(key_values)];
+    unsigned long flags;
+    size_t done = 0;
+    int n, err;
+
+    if (client->event_mode && count < sizeof(ev[0]))
+	return -EINVAL;
 
-    if (!ev_press) {
+    while (!buttons_ready(client)) {
 	if (filp->f_flags & O_NONBLOCK)
 	    return -EAGAIN;
-	else
-	    wait_event_interruptible(button_waitq, ev_press);
+	err = wait_event_interruptible(client->wait, buttons_ready(client));
+	if (err)
+	    return err;
+    }
+
+    if (!client->event_mode) {
+	spin_lock_irqsave(&button_lock, flags);
+	client->changed = 0;
+	memcpy(values, (const void *)key_values, sizeof(values));
+	spin_unlock_irqrestore(&button_lock, flags);
+
+	err = copy_to_user(buff, values, min(sizeof(values), count));
+	return err ? -EFAULT : min(sizeof(values), count);
     }
-    
-    ev_press = 0;
 
-    err = copy_to_user(buff, (const void *)key_values, min(sizeof(key_values), count));
+    /* drain as many whole events as fit, a few at a time */
+    while (count - done >= sizeof(ev[0])) {
+	spin_lock_irqsave(&button_lock, flags);
+	for (n = 0; n < ARRAY_SIZE(ev) && client->head != client->tail
+		    && count - done - n * sizeof(ev[0]) >= sizeof(ev[0]); n++) {
+	    ev[n] = client->queue[client->tail % BUTTON_QUEUE_LEN];
+	    client->tail++;
+	}
+	spin_unlock_irqrestore(&button_lock, flags);
+
+	if (n == 0)
+	    break;
+	if (copy_to_user(buff + done, ev, n * sizeof(ev[0])))
+	    return -EFAULT;
+	done += n * sizeof(ev[0]);
+    }
 
-    return err ? -EFAULT : min(sizeof(key_values), count);
+    return done;
 }
 
 static unsigned int s3c24xx_buttons_poll( struct file *file, struct poll_table_struct *wait)
 {
+    struct button_client *client = file->private_data;
     unsigned int mask = 0;
-    poll_wait(file, &button_waitq, wait);
-    if (ev_press)
+    poll_wait(file, &client->wait, wait);
+    if (buttons_ready(client))
         mask |= POLLIN | POLLRDNORM;
     return mask;
 }
 
+static int s3c24xx_buttons_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct button_client *client = file->private_data;
+    unsigned long flags;
+
+    switch (cmd) {
+    case BUTTONS_IOCTL_EVENT_MODE:
+	spin_lock_irqsave(&button_lock, flags);
+	client->event_mode = 1;
+	client->tail = client->head;
+	spin_unlock_irqrestore(&button_lock, flags);
+	return 0;
+    }
+
+    return -ENOTTY;
+}
+
 
 static struct file_operations dev_fops = {
     .owner   =   THIS_MODULE,
@@ -143,6 +322,7 @@ static struct file_operations dev_fops = {
     .release =   s3c24xx_buttons_close, 
     .read    =   s3c24xx_buttons_read,
     .poll    =   s3c24xx_buttons_poll,
+    .ioctl   =   s3c24xx_buttons_ioctl,
 };
 
 static struct miscdevice misc = {
@@ -0,0 +1,19 @@
+#ifndef _MINI2440_BUTTONS_H_
+#define _MINI2440_BUTTONS_H_
+
+#include <linux/time.h>
+
+/*
+ * by default read() returns the key state snapshot, one '0'/'1' per key.
+ * after BUTTONS_IOCTL_EVENT_MODE the file returns queued, debounced
+ * events instead, as many whole events as fit into the read buffer.
+ */
+#define BUTTONS_IOCTL_EVENT_MODE	_IO('b', 1)
+
+struct mini2440_button_event {
+	struct timespec time;		/* CLOCK_MONOTONIC, first edge */
+	unsigned short code;		/* key number, 0 ~ 5 */
+	unsigned short value;		/* 1 pressed, 0 released */
+};
+
+#endif /* _MINI2440_BUTTONS_H_ */
@@ -6,4 +6,26 @@
 #define ADC_WRITE_GETCH(data)	(((data)>>16)&0x7)
 #define ADC_WRITE_GETPRE(data)	((data)&0xff)
 
+/*
+ * continuous sampling: once a rate is set, timer 3 starts one conversion
+ * per tick and read() returns raw 16-bit samples out of the ring buffer.
+ * the ring can also be mmap()ed, ADC_GET_RING gives the byte offsets
+ * (modulo size) and ADC_RING_CONSUME hands space back to the driver.
+ */
+#define ADC_SET_CHANNEL		_IOW('a', 1, int)
+#define ADC_SET_RATE		_IOW('a', 2, unsigned int)	/* Hz, 0 = one-shot mode */
+#define ADC_GET_RING		_IOR('a', 3, struct adc_ring_info)
+#define ADC_RING_CONSUME	_IOW('a', 4, unsigned int)	/* bytes */
+
+#define ADC_MAX_RATE		20000
+
+struct adc_ring_info {
+	unsigned int size;		/* ring size in bytes, power of 2 */
+	unsigned int in;		/* producer offset, free running */
+	unsigned int out;		/* consumer offset, free running */
+	unsigned int rate;
+	unsigned long overruns;		/* samples lost because the ring was full */
+	unsigned long missed;		/* ticks lost because the ADC was busy */
+};
+
 #endif /* _S3C2410_ADC_H_ */
@@ -9,6 +9,9 @@
 #include <linux/platform_device.h>
 #include <linux/clk.h>
 #include <linux/gpio.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <asm/io.h>
 #include <asm/irq.h>
 
@@ -25,12 +28,37 @@
 #define AUTOPST	     (S3C2410_ADCTSC_YM_SEN | S3C2410_ADCTSC_YP_SEN | S3C2410_ADCTSC_XP_SEN | \
 		     S3C2410_ADCTSC_AUTO_PST | S3C2410_ADCTSC_XY_PST(0))
 
+#define TS_MAX_SAMPLES	9
+
 static char *s3c2410ts_name = "s3c2410 TouchScreen";
 
+/*
+ * Every report period the stylus_action IRQ takes 'samples' back to back
+ * auto-sequential X/Y conversions and keeps their median. An optional
+ * IIR stage, new = old + (median - old) / 2^iir_shift, smooths across
+ * reports while the pen stays down.
+ */
+static unsigned int report_rate = 200;
+module_param(report_rate, uint, 0644);
+MODULE_PARM_DESC(report_rate, "reports per second while the pen is down (10-HZ)");
+
+static unsigned int samples = 5;
+module_param(samples, uint, 0644);
+MODULE_PARM_DESC(samples, "conversions per report, median filtered (1-9)");
+
+static unsigned int iir_shift = 1;
+module_param(iir_shift, uint, 0644);
+MODULE_PARM_DESC(iir_shift, "IIR smoothing across reports, 0 disables (0-7)");
+
 static	struct input_dev *dev;
 static	long xp;
 static	long yp;
 static	int count;
+static	int nsamples;
+static	int filtered;		/* xp/yp hold a valid IIR state */
+static	unsigned short xs[TS_MAX_SAMPLES];
+static	unsigned short ys[TS_MAX_SAMPLES];
+static	struct hrtimer touch_timer;
 
 extern struct semaphore ADC_LOCK;
 static int OwnADC = 0;
@@ -45,6 +73,42 @@ static inline void s3c2410_ts_connect(void)
 	s3c2410_gpio_cfgpin(S3C2410_GPG(15), S3C2410_GPG15_nYPON);
 }
 
+static unsigned short ts_median(unsigned short *v, int n)
+{
+	unsigned short tmp;
+	int i, j;
+
+	/* n is tiny, insertion sort in place */
+	for (i = 1; i < n; i++) {
+		tmp = v[i];
+		for (j = i; j > 0 && v[j - 1] > tmp; j--)
+			v[j] = v[j - 1];
+		v[j] = tmp;
+	}
+
+	return v[n / 2];
+}
+
+/* median of this batch, then IIR against the previous report */
+static void ts_filter(void)
+{
+	unsigned int shift = min(iir_shift, 7U);
+	long x, y;
+
+	/* the panel is mounted rotated, X comes from ADCDAT1 */
+	x = ts_median(ys, count);
+	y = ts_median(xs, count);
+
+	if (!filtered || shift == 0) {
+		xp = x;
+		yp = y;
+		filtered = 1;
+	} else {
+		xp += (x - xp) >> shift;
+		yp += (y - yp) >> shift;
+	}
+}
+
 static void touch_timer_fire(unsigned long data)
 {
   	unsigned long data0;
@@ -57,16 +121,8 @@ static void touch_timer_fire(unsigned long data)
  	updown = (!(data0 & S3C2410_ADCDAT0_UPDOWN)) && (!(data1 & S3C2410_ADCDAT0_UPDOWN));
 
  	if (updown) {
+		/* one coalesced report per period, a single input_sync */
  		if (count != 0) {
-			long tmp;
-                                                                                                 
-			tmp = xp;
-			xp = yp;
-			yp = tmp;
-                                                                                                 
-                        xp >>= 2;
-                        yp >>= 2;
-
  			input_report_abs(dev, ABS_X, xp);
  			input_report_abs(dev, ABS_Y, yp);
 
@@ -75,14 +131,14 @@ static void touch_timer_fire(unsigned long data)
  			input_sync(dev);
  		}
 
- 		xp = 0;
- 		yp = 0;
  		count = 0;
+		nsamples = clamp_t(unsigned int, samples, 1, TS_MAX_SAMPLES);
 
  		iowrite32(S3C2410_ADCTSC_PULL_UP_DISABLE | AUTOPST, base_addr+S3C2410_ADCTSC);
  		iowrite32(ioread32(base_addr+S3C2410_ADCCON) | S3C2410_ADCCON_ENABLE_START, base_addr+S3C2410_ADCCON);
  	} else {
  		count = 0;
+		filtered = 0;
 
  		input_report_key(dev, BTN_TOUCH, 0);
  		input_report_abs(dev, ABS_PRESSURE, 0);
@@ -96,8 +152,11 @@ static void touch_timer_fire(unsigned long data)
  	}
 }
 
-static struct timer_list touch_timer =
-		TIMER_INITIALIZER(touch_timer_fire, 0, 0);
+static enum hrtimer_restart touch_timer_expired(struct hrtimer *timer)
+{
+	touch_timer_fire(0);
+	return HRTIMER_NORESTART;
+}
 
 static irqreturn_t stylus_updown(int irq, void *dev_id)
 {
@@ -133,15 +192,19 @@ static irqreturn_t stylus_action(int irq, void *dev_id)
 		data0 = ioread32(base_addr+S3C2410_ADCDAT0);
 		data1 = ioread32(base_addr+S3C2410_ADCDAT1);
 
-		xp += data0 & S3C2410_ADCDAT0_XPDATA_MASK;
-		yp += data1 & S3C2410_ADCDAT1_YPDATA_MASK;
+		xs[count] = data0 & S3C2410_ADCDAT0_XPDATA_MASK;
+		ys[count] = data1 & S3C2410_ADCDAT1_YPDATA_MASK;
 		count++;
 
-	    if (count < (1<<2)) {
+	    if (count < nsamples) {
 			iowrite32(S3C2410_ADCTSC_PULL_UP_DISABLE | AUTOPST, base_addr+S3C2410_ADCTSC);
 			iowrite32(ioread32(base_addr+S3C2410_ADCCON) | S3C2410_ADCCON_ENABLE_START, base_addr+S3C2410_ADCCON);
 		} else {
-			mod_timer(&touch_timer, jiffies+1);
+			/* no GENERIC_CLOCKEVENTS here, hrtimers expire on the tick */
+			unsigned int rate = clamp_t(unsigned int, report_rate, 10, HZ);
+
+			ts_filter();
+			hrtimer_start(&touch_timer, ktime_set(0, NSEC_PER_SEC / rate), HRTIMER_MODE_REL);
 			iowrite32(WAIT4INT(1), base_addr+S3C2410_ADCTSC);
 		}
 	}
@@ -171,6 +234,10 @@ static int __init s3c2410ts_init(void)
 	/* Configure GPIOs */
 	s3c2410_ts_connect();
 
+	hrtimer_init(&touch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	touch_timer.function = touch_timer_expired;
+	nsamples = clamp_t(unsigned int, samples, 1, TS_MAX_SAMPLES);
+
 	iowrite32(S3C2410_ADCCON_PRSCEN | S3C2410_ADCCON_PRSCVL(0xFF),\
 		     base_addr+S3C2410_ADCCON);
 	iowrite32(0xffff,  base_addr+S3C2410_ADCDLY);
@@ -226,6 +293,7 @@ static void __exit s3c2410ts_exit(void)
 	disable_irq(IRQ_TC);
 	free_irq(IRQ_TC,dev);
 	free_irq(IRQ_ADC,dev);
+	hrtimer_cancel(&touch_timer);
 
 	if (adc_clock) {
 		clk_disable(adc_clock);
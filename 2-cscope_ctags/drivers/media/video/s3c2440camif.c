@@ -21,6 +21,14 @@
 #include <linux/highmem.h>
 #include <linux/miscdevice.h>
 #include <linux/gpio.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 
 #include <asm/io.h>
 #include <asm/memory.h>
@@ -225,6 +233,42 @@ static void __inline__ update_source_fmt_regs(struct s3c2440camif_dev * pdev)
 	iowrite32(cisrcfmt, S3C244X_CISRCFMT);
 }
 
+/* the physical address frame slot 'slot' should point at. */
+static unsigned long __inline__ camif_slot_phys(struct s3c2440camif_dev * pdev, int slot)
+{
+	if (!pdev->streaming)
+	{
+		return img_buff[slot].phy_base;
+	}
+
+	/* while streaming, slots without a queued buffer capture into scratch. */
+	if (pdev->slot[slot] == NULL)
+	{
+		return pdev->scratch_phys;
+	}
+	return pdev->slot[slot]->phy_base;
+}
+
+/* program frame slot 'slot' of the preview or codec path. */
+static void __inline__ camif_write_slot(struct s3c2440camif_dev * pdev, int codec, int slot)
+{
+	unsigned long phys;
+	u32 ysize;
+
+	phys = camif_slot_phys(pdev, slot);
+	if (!codec)
+	{
+		iowrite32(phys, S3C244X_CIPRCLRSA1 + slot * 4);
+		return;
+	}
+
+	/* codec path writes planar YCbCr 4:2:2, Y, then Cb, then Cr. */
+	ysize = pdev->coTargetHsize * pdev->coTargetVsize;
+	iowrite32(phys, S3C244X_CICOYSA1 + slot * 4);
+	iowrite32(phys + ysize, S3C244X_CICOCBSA1 + slot * 4);
+	iowrite32(phys + ysize + ysize / 2, S3C244X_CICOCRSA1 + slot * 4);
+}
+
 /* update registers:
  *	PREVIEW path:
  *		CIPRCLRSA1 ~ CIPRCLRSA4
@@ -249,10 +293,10 @@ static void __inline__ update_target_fmt_regs(struct s3c2440camif_dev * pdev)
 	u32 mainBurstSize, remainedBurstSize;
 
 		/* CIPRCLRSA1 ~ CIPRCLRSA4. */
-		iowrite32(img_buff[0].phy_base, S3C244X_CIPRCLRSA1);
-		iowrite32(img_buff[1].phy_base, S3C244X_CIPRCLRSA2);
-		iowrite32(img_buff[2].phy_base, S3C244X_CIPRCLRSA3);
-		iowrite32(img_buff[3].phy_base, S3C244X_CIPRCLRSA4);
+		camif_write_slot(pdev, 0, 0);
+		camif_write_slot(pdev, 0, 1);
+		camif_write_slot(pdev, 0, 2);
+		camif_write_slot(pdev, 0, 3);
 
 		/* CIPRTRGFMT. */
 		ciprtrgfmt = (pdev->preTargetHsize<<16)		// horizontal pixel number of target image
@@ -706,6 +750,60 @@ static void __inline__ free_image_buffer(void)
 	img_buff[3].phy_base = (unsigned long)NULL;
 }
 
+/*
+ * hand the frame just DMAed into slot 'frame' over to the done list and
+ * rotate the next queued buffer into that slot, called only in ISR.
+ *
+ * the hardware is already filling the following slot, so reprogramming
+ * this one is safe and no image data is ever copied.  without a queued
+ * buffer the slot captures into the scratch buffer and the frame counts
+ * as dropped.
+ */
+static void camif_stream_frame_done(struct s3c2440camif_dev * pdev, int codec, u32 frame)
+{
+	struct s3c2440camif_buffer * buf;
+	struct s3c2440camif_buffer * next;
+
+	spin_lock(&pdev->slock);
+	if (!pdev->streaming)
+	{
+		spin_unlock(&pdev->slock);
+		return;
+	}
+
+	pdev->stats.frames++;
+	buf = pdev->slot[frame];
+	if (buf != NULL)
+	{
+		buf->sequence = pdev->sequence;
+		do_gettimeofday(&buf->timestamp);
+		buf->done_time = ktime_get();
+		buf->stream_state = CAMIF_STREAM_DONE;
+		list_add_tail(&buf->list, &pdev->done);
+	}
+	else
+	{
+		pdev->stats.dropped++;
+	}
+	pdev->sequence++;
+
+	next = NULL;
+	if (!list_empty(&pdev->queued))
+	{
+		next = list_first_entry(&pdev->queued, struct s3c2440camif_buffer, list);
+		list_del(&next->list);
+		next->stream_state = CAMIF_STREAM_ACTIVE;
+	}
+	pdev->slot[frame] = next;
+	camif_write_slot(pdev, codec, frame);
+	spin_unlock(&pdev->slock);
+
+	if (buf != NULL)
+	{
+		wake_up_interruptible(&pdev->donequeue);
+	}
+}
+
 /*
  * ISR: service for C-path interrupt.
  */
@@ -728,6 +826,11 @@ static irqreturn_t on_camif_irq_c(int irq, void * dev)
 	frame = (cicostatus&(3<<26))>>26;
 	frame = (frame+4-1)%4;
 
+	if (pdev->state == CAMIF_STATE_CODECING)
+	{
+		camif_stream_frame_done(pdev, 1, frame);
+	}
+
 	if (pdev->cmdcode & CAMIF_CMD_STOP)
 	{
 		stop_capture(pdev);
@@ -786,6 +889,11 @@ static irqreturn_t on_camif_irq_p(int irq, void * dev)
 	frame = (ciprstatus&(3<<26))>>26;
 	frame = (frame+4-1)%4;
 
+	if (pdev->state == CAMIF_STATE_PREVIEWING)
+	{
+		camif_stream_frame_done(pdev, 0, frame);
+	}
+
 		img_buff[frame].state = CAMIF_BUFF_RGB565;
 
 	if (pdev->cmdcode & CAMIF_CMD_STOP)
@@ -899,6 +1007,11 @@ static ssize_t camif_read(struct file *file, char __user *data, size_t count, lo
 	fh = file->private_data;
 	pdev = fh->dev;
 
+	/* the buffers belong to the streaming queue, use VIDIOC_DQBUF. */
+	if (pdev->streaming)
+	{
+		return -EBUSY;
+	}
 
 	if (start_capture(pdev, 0) != 0)
 	{
@@ -922,6 +1035,567 @@ static ssize_t camif_read(struct file *file, char __user *data, size_t count, lo
 	return count;
 }
 
+/* bytes of one preview (RGB565) frame. */
+static __inline__ u32 camif_stream_bytes(struct s3c2440camif_dev * pdev)
+{
+	return pdev->preTargetHsize * pdev->preTargetVsize * 2;
+}
+
+/* distance between two buffers in the mmap offset space. */
+static __inline__ unsigned long camif_stream_stride(void)
+{
+	return PAGE_SIZE << img_buff[0].order;
+}
+
+static void camif_fill_v4l2_buffer(struct s3c2440camif_dev * pdev,
+		struct s3c2440camif_buffer * buf, struct v4l2_buffer * vb)
+{
+	memset(vb, 0, sizeof(*vb));
+	vb->index = buf->index;
+	vb->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	vb->memory = V4L2_MEMORY_MMAP;
+	vb->field = V4L2_FIELD_NONE;
+	vb->m.offset = buf->index * camif_stream_stride();
+	vb->length = PAGE_ALIGN(camif_stream_bytes(pdev));
+
+	switch (buf->stream_state)
+	{
+	case CAMIF_STREAM_QUEUED:
+	case CAMIF_STREAM_ACTIVE:
+		vb->flags |= V4L2_BUF_FLAG_QUEUED;
+		break;
+	case CAMIF_STREAM_DONE:
+		vb->flags |= V4L2_BUF_FLAG_DONE;
+		break;
+	}
+
+	vb->bytesused = camif_stream_bytes(pdev);
+	vb->sequence = buf->sequence;
+	vb->timestamp = buf->timestamp;
+}
+
+/* give the streaming buffers back, only when not streaming. */
+static void camif_stream_release(struct s3c2440camif_dev * pdev)
+{
+	int i;
+
+	for (i = 0; i < pdev->nbufs; i++)
+	{
+		dma_unmap_single(NULL, img_buff[i].phy_base,
+				camif_stream_stride(), DMA_FROM_DEVICE);
+		img_buff[i].stream_state = CAMIF_STREAM_IDLE;
+	}
+	pdev->nbufs = 0;
+
+	if (pdev->scratch_virt != (unsigned long)NULL)
+	{
+		free_pages(pdev->scratch_virt, pdev->scratch_order);
+		pdev->scratch_virt = (unsigned long)NULL;
+		pdev->scratch_phys = (unsigned long)NULL;
+	}
+	pdev->stream_owner = NULL;
+}
+
+static int camif_reqbufs(struct s3c2440camif_fh * fh, struct v4l2_requestbuffers * req)
+{
+	struct s3c2440camif_dev * pdev;
+	int i;
+
+	pdev = fh->dev;
+
+	if (req->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || req->memory != V4L2_MEMORY_MMAP)
+	{
+		return -EINVAL;
+	}
+	if (pdev->streaming)
+	{
+		return -EBUSY;
+	}
+
+	camif_stream_release(pdev);
+	if (req->count == 0)
+	{
+		return 0;
+	}
+
+	/* the buffers allocated by init_image_buffer() are the only ones. */
+	if (req->count > CAMIF_NR_SLOTS)
+	{
+		req->count = CAMIF_NR_SLOTS;
+	}
+
+	for (i = 0; i < req->count; i++)
+	{
+		img_buff[i].index = i;
+		img_buff[i].stream_state = CAMIF_STREAM_IDLE;
+		img_buff[i].sequence = 0;
+
+		/* the kernel never touches the buffer again, invalidate it once. */
+		dma_map_single(NULL, (void *)img_buff[i].virt_base,
+				camif_stream_stride(), DMA_FROM_DEVICE);
+	}
+	pdev->nbufs = req->count;
+	pdev->stream_owner = fh;
+
+	return 0;
+}
+
+static int camif_querybuf(struct s3c2440camif_fh * fh, struct v4l2_buffer * vb)
+{
+	struct s3c2440camif_dev * pdev;
+	unsigned long flags;
+
+	pdev = fh->dev;
+
+	if (vb->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || vb->index >= pdev->nbufs)
+	{
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&pdev->slock, flags);
+	camif_fill_v4l2_buffer(pdev, &img_buff[vb->index], vb);
+	spin_unlock_irqrestore(&pdev->slock, flags);
+
+	return 0;
+}
+
+static int camif_qbuf(struct s3c2440camif_fh * fh, struct v4l2_buffer * vb)
+{
+	struct s3c2440camif_dev * pdev;
+	struct s3c2440camif_buffer * buf;
+	unsigned long flags;
+	int ret;
+
+	pdev = fh->dev;
+
+	if (vb->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || vb->memory != V4L2_MEMORY_MMAP
+		|| vb->index >= pdev->nbufs)
+	{
+		return -EINVAL;
+	}
+	buf = &img_buff[vb->index];
+
+	/* the ISR moves it into a hardware slot once that slot completes. */
+	ret = -EINVAL;
+	spin_lock_irqsave(&pdev->slock, flags);
+	if (buf->stream_state == CAMIF_STREAM_IDLE)
+	{
+		buf->stream_state = CAMIF_STREAM_QUEUED;
+		list_add_tail(&buf->list, &pdev->queued);
+		camif_fill_v4l2_buffer(pdev, buf, vb);
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&pdev->slock, flags);
+
+	return ret;
+}
+
+/* called without rcmutex held, so that QBUF is not blocked while waiting. */
+static int camif_dqbuf(struct file * file, struct s3c2440camif_fh * fh, struct v4l2_buffer * vb)
+{
+	struct s3c2440camif_dev * pdev;
+	struct s3c2440camif_buffer * buf;
+	unsigned long flags;
+	unsigned long latency;
+	int streaming;
+	int ret;
+
+	pdev = fh->dev;
+
+	if (vb->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || vb->memory != V4L2_MEMORY_MMAP)
+	{
+		return -EINVAL;
+	}
+
+	while (1)
+	{
+		spin_lock_irqsave(&pdev->slock, flags);
+		if (!list_empty(&pdev->done))
+		{
+			break;
+		}
+		streaming = pdev->streaming;
+		spin_unlock_irqrestore(&pdev->slock, flags);
+
+		if (!streaming)
+		{
+			return -EINVAL;
+		}
+		if (file->f_flags & O_NONBLOCK)
+		{
+			return -EAGAIN;
+		}
+
+		ret = wait_event_interruptible(pdev->donequeue,
+				!list_empty(&pdev->done) || !pdev->streaming);
+		if (ret != 0)
+		{
+			return ret;
+		}
+	}
+
+	buf = list_first_entry(&pdev->done, struct s3c2440camif_buffer, list);
+	list_del(&buf->list);
+
+	latency = (unsigned long)ktime_us_delta(ktime_get(), buf->done_time);
+	pdev->stats.dequeued++;
+	pdev->stats.latency_total += latency;
+	if (latency > pdev->stats.latency_max)
+	{
+		pdev->stats.latency_max = latency;
+	}
+
+	camif_fill_v4l2_buffer(pdev, buf, vb);
+	buf->stream_state = CAMIF_STREAM_IDLE;
+	spin_unlock_irqrestore(&pdev->slock, flags);
+
+	return 0;
+}
+
+static int camif_streamon(struct s3c2440camif_fh * fh)
+{
+	struct s3c2440camif_dev * pdev;
+	struct s3c2440camif_buffer * buf;
+	unsigned long flags;
+	int i;
+
+	pdev = fh->dev;
+
+	if (pdev->nbufs == 0)
+	{
+		return -EINVAL;
+	}
+	if (pdev->streaming)
+	{
+		return 0;
+	}
+	if (pdev->state != CAMIF_STATE_READY)
+	{
+		return -EBUSY;
+	}
+
+	/* frames without a queued buffer land here, big enough for either path. */
+	if (pdev->scratch_virt == (unsigned long)NULL)
+	{
+		pdev->scratch_order = img_buff[0].order;
+		pdev->scratch_virt = __get_free_pages(GFP_KERNEL|GFP_DMA, pdev->scratch_order);
+		if (pdev->scratch_virt == (unsigned long)NULL)
+		{
+			return -ENOMEM;
+		}
+		pdev->scratch_phys = pdev->scratch_virt - PAGE_OFFSET + PHYS_OFFSET;	// the DMA address.
+	}
+
+	spin_lock_irqsave(&pdev->slock, flags);
+	memset(&pdev->stats, 0, sizeof(pdev->stats));
+	pdev->sequence = 0;
+	for (i = 0; i < CAMIF_NR_SLOTS; i++)
+	{
+		buf = NULL;
+		if (!list_empty(&pdev->queued))
+		{
+			buf = list_first_entry(&pdev->queued, struct s3c2440camif_buffer, list);
+			list_del(&buf->list);
+			buf->stream_state = CAMIF_STREAM_ACTIVE;
+		}
+		pdev->slot[i] = buf;
+	}
+	pdev->streaming = 1;
+	for (i = 0; i < CAMIF_NR_SLOTS; i++)
+	{
+		camif_write_slot(pdev, 0, i);
+	}
+	spin_unlock_irqrestore(&pdev->slock, flags);
+
+	return start_capture(pdev, 1);
+}
+
+static int camif_streamoff(struct s3c2440camif_fh * fh)
+{
+	struct s3c2440camif_dev * pdev;
+	unsigned long flags;
+	int i;
+
+	pdev = fh->dev;
+
+	if (!pdev->streaming)
+	{
+		return 0;
+	}
+
+	update_camif_config(fh, CAMIF_CMD_STOP);	// returns after the ISR stopped capture.
+
+	spin_lock_irqsave(&pdev->slock, flags);
+	pdev->streaming = 0;
+	INIT_LIST_HEAD(&pdev->queued);
+	INIT_LIST_HEAD(&pdev->done);
+	for (i = 0; i < CAMIF_NR_SLOTS; i++)
+	{
+		pdev->slot[i] = NULL;
+	}
+	for (i = 0; i < pdev->nbufs; i++)
+	{
+		img_buff[i].stream_state = CAMIF_STREAM_IDLE;
+	}
+
+	/* point the slots back to img_buff[] for camif_read(). */
+	for (i = 0; i < CAMIF_NR_SLOTS; i++)
+	{
+		camif_write_slot(pdev, 0, i);
+	}
+	spin_unlock_irqrestore(&pdev->slock, flags);
+
+	wake_up_interruptible(&pdev->donequeue);
+
+	return 0;
+}
+
+/*
+ * camif_ioctl(), V4L2 streaming i/o on top of the misc device.
+ */
+static long camif_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct s3c2440camif_fh * fh;
+	struct s3c2440camif_dev * pdev;
+	void __user * argp = (void __user *)arg;
+	struct v4l2_capability cap;
+	struct v4l2_requestbuffers req;
+	struct v4l2_buffer vb;
+	int type;
+	int ret;
+
+	fh = file->private_data;
+	pdev = fh->dev;
+
+	switch (cmd)
+	{
+	case VIDIOC_QUERYCAP:
+		memset(&cap, 0, sizeof(cap));
+		strlcpy(cap.driver, "s3c2440camif", sizeof(cap.driver));
+		strlcpy(cap.card, CARD_NAME, sizeof(cap.card));
+		cap.version = KERNEL_VERSION(0, 1, 0);
+		cap.capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_READWRITE | V4L2_CAP_STREAMING;
+		return copy_to_user(argp, &cap, sizeof(cap)) ? -EFAULT : 0;
+
+	case VIDIOC_DQBUF:
+		if (copy_from_user(&vb, argp, sizeof(vb)))
+		{
+			return -EFAULT;
+		}
+		if (pdev->stream_owner != fh)
+		{
+			return -EBUSY;
+		}
+		ret = camif_dqbuf(file, fh, &vb);
+		if (ret == 0 && copy_to_user(argp, &vb, sizeof(vb)))
+		{
+			ret = -EFAULT;
+		}
+		return ret;
+	}
+
+	mutex_lock(&pdev->rcmutex);
+	if (pdev->stream_owner != NULL && pdev->stream_owner != fh)
+	{
+		ret = -EBUSY;
+		goto out;
+	}
+
+	switch (cmd)
+	{
+	case VIDIOC_REQBUFS:
+		ret = -EFAULT;
+		if (copy_from_user(&req, argp, sizeof(req)))
+		{
+			break;
+		}
+		ret = camif_reqbufs(fh, &req);
+		if (ret == 0 && copy_to_user(argp, &req, sizeof(req)))
+		{
+			ret = -EFAULT;
+		}
+		break;
+
+	case VIDIOC_QUERYBUF:
+	case VIDIOC_QBUF:
+		ret = -EFAULT;
+		if (copy_from_user(&vb, argp, sizeof(vb)))
+		{
+			break;
+		}
+		if (cmd == VIDIOC_QUERYBUF)
+		{
+			ret = camif_querybuf(fh, &vb);
+		}
+		else
+		{
+			ret = camif_qbuf(fh, &vb);
+		}
+		if (ret == 0 && copy_to_user(argp, &vb, sizeof(vb)))
+		{
+			ret = -EFAULT;
+		}
+		break;
+
+	case VIDIOC_STREAMON:
+	case VIDIOC_STREAMOFF:
+		ret = -EFAULT;
+		if (get_user(type, (int __user *)argp))
+		{
+			break;
+		}
+		ret = -EINVAL;
+		if (type != V4L2_BUF_TYPE_VIDEO_CAPTURE || pdev->stream_owner != fh)
+		{
+			break;
+		}
+		if (cmd == VIDIOC_STREAMON)
+		{
+			ret = camif_streamon(fh);
+		}
+		else
+		{
+			ret = camif_streamoff(fh);
+		}
+		break;
+
+	default:
+		ret = -ENOIOCTLCMD;
+		break;
+	}
+
+out:
+	mutex_unlock(&pdev->rcmutex);
+	return ret;
+}
+
+/*
+ * camif_mmap(), map one of the DMA image buffers, see VIDIOC_QUERYBUF.
+ */
+static int camif_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct s3c2440camif_fh * fh;
+	struct s3c2440camif_dev * pdev;
+	unsigned long offset;
+	unsigned long size;
+	unsigned int index;
+	int ret;
+
+	fh = file->private_data;
+	pdev = fh->dev;
+
+	offset = vma->vm_pgoff << PAGE_SHIFT;
+	size = vma->vm_end - vma->vm_start;
+	index = offset / camif_stream_stride();
+
+	if (!(vma->vm_flags & VM_SHARED))
+	{
+		return -EINVAL;
+	}
+
+	mutex_lock(&pdev->rcmutex);
+	ret = -EINVAL;
+	if (pdev->stream_owner == fh && index < pdev->nbufs
+		&& (offset % camif_stream_stride()) == 0 && size <= camif_stream_stride())
+	{
+		/* the camif writes behind the cache, so map it uncached. */
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+		ret = remap_pfn_range(vma, vma->vm_start,
+				img_buff[index].phy_base >> PAGE_SHIFT, size, vma->vm_page_prot);
+	}
+	mutex_unlock(&pdev->rcmutex);
+
+	return ret;
+}
+
+/*
+ * camif_poll(), readable once a streaming buffer can be dequeued.
+ */
+static unsigned int camif_poll(struct file *file, struct poll_table_struct *wait)
+{
+	struct s3c2440camif_fh * fh;
+	struct s3c2440camif_dev * pdev;
+
+	fh = file->private_data;
+	pdev = fh->dev;
+
+	/* camif_read() always blocks until it has a frame. */
+	if (!pdev->streaming)
+	{
+		return POLLIN | POLLRDNORM;
+	}
+
+	poll_wait(file, &pdev->donequeue, wait);
+	if (!list_empty(&pdev->done))
+	{
+		return POLLIN | POLLRDNORM;
+	}
+	return 0;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int camif_stats_show(struct seq_file *seq, void *v)
+{
+	struct s3c2440camif_dev * pdev = seq->private;
+	struct s3c2440camif_stats stats;
+	unsigned long flags;
+	u64 avg;
+
+	spin_lock_irqsave(&pdev->slock, flags);
+	stats = pdev->stats;
+	spin_unlock_irqrestore(&pdev->slock, flags);
+
+	avg = stats.dequeued ? div64_u64(stats.latency_total, stats.dequeued) : 0;
+
+	seq_printf(seq, "streaming:\t%d\n", pdev->streaming);
+	seq_printf(seq, "buffers:\t%d\n", pdev->nbufs);
+	seq_printf(seq, "frames:\t\t%lu\n", stats.frames);
+	seq_printf(seq, "dropped:\t%lu\n", stats.dropped);
+	seq_printf(seq, "dequeued:\t%lu\n", stats.dequeued);
+	seq_printf(seq, "latency:\t%llu us avg, %lu us max\n",
+			(unsigned long long)avg, stats.latency_max);
+
+	return 0;
+}
+
+static int camif_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, camif_stats_show, inode->i_private);
+}
+
+static const struct file_operations camif_stats_fops =
+{
+	.owner		= THIS_MODULE,
+	.open		= camif_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void camif_debugfs_attach(struct s3c2440camif_dev * pdev)
+{
+	pdev->debug_root = debugfs_create_dir("s3c2440camif", NULL);
+	if (pdev->debug_root == NULL)
+	{
+		printk(KERN_ERR"s3c2440camif: failed to create debugfs root\n");
+		return;
+	}
+
+	if (debugfs_create_file("stats", 0444, pdev->debug_root, pdev, &camif_stats_fops) == NULL)
+	{
+		printk(KERN_ERR"s3c2440camif: failed to create debugfs stats\n");
+	}
+}
+
+static void camif_debugfs_remove(struct s3c2440camif_dev * pdev)
+{
+	debugfs_remove_recursive(pdev->debug_root);
+}
+#else
+static __inline__ void camif_debugfs_attach(struct s3c2440camif_dev * pdev) { }
+static __inline__ void camif_debugfs_remove(struct s3c2440camif_dev * pdev) { }
+#endif /* CONFIG_DEBUG_FS */
+
 /*
  * camif_release()
  */
@@ -933,6 +1607,13 @@ static int camif_release(struct inode *inode, struct file *file)
 	fh = file->private_data;
 	pdev = fh->dev;
 
+	mutex_lock(&pdev->rcmutex);
+	if (pdev->stream_owner == fh)
+	{
+		camif_streamoff(fh);
+		camif_stream_release(pdev);
+	}
+	mutex_unlock(&pdev->rcmutex);
 
 		clk_disable(pdev->clk);				// stop camif clock
 
@@ -954,6 +1635,9 @@ static struct file_operations camif_fops =
 	.open		= camif_open,
 	.release	= camif_release,
 	.read		= camif_read,
+	.unlocked_ioctl	= camif_ioctl,
+	.mmap		= camif_mmap,
+	.poll		= camif_poll,
 };
 
 static struct miscdevice misc = {
@@ -1040,6 +1724,12 @@ static int __init camif_init(void)
 	pdev->cmdcode = CAMIF_CMD_NONE;
 	init_waitqueue_head(&pdev->cmdqueue);
 
+	/* init streaming i/o queues. */
+	spin_lock_init(&pdev->slock);
+	INIT_LIST_HEAD(&pdev->queued);
+	INIT_LIST_HEAD(&pdev->done);
+	init_waitqueue_head(&pdev->donequeue);
+
 	/* register to videodev layer. */
 	if (misc_register(&misc) < 0)
 	{
@@ -1052,6 +1742,7 @@ static int __init camif_init(void)
 	hw_reset_camif();
 	has_ov9650 = s3c2440_ov9650_init() >= 0;
 	s3c2410_gpio_setpin(S3C2410_GPG(4), 1);
+	camif_debugfs_attach(pdev);
 	return 0;
 
 error4:
@@ -1077,6 +1768,7 @@ static void __exit camif_cleanup(void)
 	pdev = &camera;
 
 	misc_deregister(&misc);
+	camif_debugfs_remove(pdev);
 
 
 	clk_put(pdev->clk);
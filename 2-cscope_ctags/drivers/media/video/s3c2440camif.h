@@ -29,6 +29,36 @@ struct s3c2440camif_buffer
 	unsigned int order;
 	unsigned long virt_base;
 	unsigned long phy_base;
+
+	/* streaming i/o (VIDIOC_REQBUFS/QBUF/DQBUF). */
+	int index;
+	int stream_state;			// CAMIF_STREAM_IDLE, CAMIF_STREAM_QUEUED, etc.
+	struct list_head list;		// on s3c2440camif_dev->queued or ->done.
+	u32 sequence;
+	struct timeval timestamp;
+	ktime_t done_time;			// when the ISR handed the frame over.
+};
+
+/* for s3c2440camif_buffer->stream_state field. */
+enum
+{
+	CAMIF_STREAM_IDLE = 0,		// owned by userspace (or not requested)
+	CAMIF_STREAM_QUEUED = 1,	// queued, waiting for a free hardware slot
+	CAMIF_STREAM_ACTIVE = 2,	// programmed into one of the 4 hardware slots
+	CAMIF_STREAM_DONE = 3		// filled, waiting to be dequeued
+};
+
+/* number of frame address slots per path (CIPRCLRSA1~4, CICOYSA1~4). */
+#define CAMIF_NR_SLOTS		4
+
+/* streaming i/o statistics. */
+struct s3c2440camif_stats
+{
+	unsigned long frames;		// frames completed while streaming.
+	unsigned long dropped;		// frames landed in the scratch buffer.
+	unsigned long dequeued;		// buffers returned by VIDIOC_DQBUF.
+	u64 latency_total;			// frame end to VIDIOC_DQBUF, in us.
+	unsigned long latency_max;
 };
 
 /* for s3c2440camif_dev->state field. */
@@ -95,6 +125,24 @@ struct s3c2440camif_dev
 	/* for executing camif commands. */
 	int cmdcode;				// command code, CAMIF_CMD_START, CAMIF_CMD_CFG, etc.
 	wait_queue_head_t cmdqueue;	// wait queue for waiting untile command completed (if in preview or in capturing).
+
+	/* streaming i/o, the buffers are img_buff[0 ~ nbufs-1]. */
+	int nbufs;
+	int streaming;
+	struct s3c2440camif_fh * stream_owner;
+	spinlock_t slock;			// protects the lists, slot[] and stats.
+	struct list_head queued;
+	struct list_head done;
+	wait_queue_head_t donequeue;
+	struct s3c2440camif_buffer * slot[CAMIF_NR_SLOTS];	// NULL means scratch.
+	unsigned long scratch_virt;
+	unsigned long scratch_phys;
+	unsigned int scratch_order;
+	u32 sequence;
+	struct s3c2440camif_stats stats;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry * debug_root;
+#endif
 };
 
 /* opened file handle.*/
@@ -23,6 +23,9 @@
 #include <linux/irq.h>
 #include <linux/io.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 
 #include <mach/dma.h>
 
@@ -797,7 +800,10 @@ static void s3cmci_dma_done_callback(struct s3c2410_dma_chan *dma_ch,
 			"DCNT:[%08x] toGo:%u\n",
 			size, mci_dsta, mci_dcnt, host->dmatogo);
 
-		goto out;
+		/* the DMA core already loaded the next buffer, nothing to
+		 * do until the last one completes */
+		spin_unlock_irqrestore(&host->complete_lock, iflags);
+		return;
 	}
 
 	dbg(host, dbg_dma, "DMA FINISHED Size:%i DSTA:%08x DCNT:%08x\n",
@@ -819,6 +825,36 @@ fail_request:
 	goto out;
 }
 
+/**
+ * s3cmci_account - update the transfer statistics for a finished request
+ * @host: The host state
+ * @data: The data part of the request
+ */
+static void s3cmci_account(struct s3cmci_host *host, struct mmc_data *data)
+{
+	struct s3cmci_stats *stats = &host->stats[!!(data->flags & MMC_DATA_WRITE)];
+	s64 usecs;
+	int bucket;
+
+	if (data->error) {
+		stats->errors++;
+		return;
+	}
+
+	usecs = ktime_us_delta(ktime_get(), host->req_start);
+	if (usecs < 0)
+		usecs = 0;
+
+	bucket = usecs < 128 ? 0 : ilog2(usecs) - 6;
+	if (bucket >= S3CMCI_LAT_BUCKETS)
+		bucket = S3CMCI_LAT_BUCKETS - 1;
+
+	stats->requests++;
+	stats->bytes += data->bytes_xfered;
+	stats->usecs += usecs;
+	stats->latency[bucket]++;
+}
+
 static void finalize_request(struct s3cmci_host *host)
 {
 	struct mmc_request *mrq = host->mrq;
@@ -883,6 +919,14 @@ static void finalize_request(struct s3cmci_host *host)
 		mrq->data->bytes_xfered = 0;
 	}
 
+	if (s3cmci_host_usedma(host))
+		dma_unmap_sg(mmc_dev(host->mmc), mrq->data->sg,
+			     mrq->data->sg_len,
+			     (mrq->data->flags & MMC_DATA_WRITE) ?
+			     DMA_TO_DEVICE : DMA_FROM_DEVICE);
+
+	s3cmci_account(host, mrq->data);
+
 	/* If we had an error while transfering data we flush the
 	 * DMA channel and the fifo to clear out any garbage. */
 	if (mrq->data->error != 0) {
@@ -1081,10 +1125,23 @@ static int s3cmci_prepare_pio(struct s3cmci_host *host, struct mmc_data *data)
 	return 0;
 }
 
+/**
+ * s3cmci_prepare_dma - queue the whole scatterlist on the DMA channel
+ * @host: The host state
+ * @data: The data to transfer
+ *
+ * Every sg entry is queued before the channel is started, so the DMA
+ * core reloads the next buffer from its completion interrupt and a
+ * multi-block transfer streams without waking the tasklet in between.
+ * Physically contiguous entries are merged into one buffer to cut the
+ * number of reloads.
+ */
 static int s3cmci_prepare_dma(struct s3cmci_host *host, struct mmc_data *data)
 {
-	int dma_len, i;
+	int dma_len, i, nr_bufs;
 	int rw = data->flags & MMC_DATA_WRITE;
+	dma_addr_t addr;
+	unsigned int len;
 
 	BUG_ON((data->flags & BOTH_DIR) == BOTH_DIR);
 
@@ -1097,24 +1154,46 @@ static int s3cmci_prepare_dma(struct s3cmci_host *host, struct mmc_data *data)
 	if (dma_len == 0)
 		return -ENOMEM;
 
+	/* count the buffers first, the callback may run once the first
+	 * one is queued as the channel autostarts */
+	nr_bufs = 1;
+	for (i = 1; i < dma_len; i++)
+		if (sg_dma_address(&data->sg[i]) !=
+		    sg_dma_address(&data->sg[i - 1]) +
+		    sg_dma_len(&data->sg[i - 1]))
+			nr_bufs++;
+
 	host->dma_complete = 0;
-	host->dmatogo = dma_len;
+	host->dmatogo = nr_bufs;
+	host->stats[!!rw].segments += nr_bufs;
 
-	for (i = 0; i < dma_len; i++) {
+	addr = sg_dma_address(&data->sg[0]);
+	len = sg_dma_len(&data->sg[0]);
+
+	for (i = 1; i <= dma_len; i++) {
 		int res;
 
-		dbg(host, dbg_dma, "enqueue %i: %08x@%u\n", i,
-		    sg_dma_address(&data->sg[i]),
-		    sg_dma_len(&data->sg[i]));
+		if (i < dma_len && sg_dma_address(&data->sg[i]) == addr + len) {
+			len += sg_dma_len(&data->sg[i]);
+			continue;
+		}
 
-		res = s3c2410_dma_enqueue(host->dma, host,
-					  sg_dma_address(&data->sg[i]),
-					  sg_dma_len(&data->sg[i]));
+		dbg(host, dbg_dma, "enqueue %i: %08x@%u\n", i,
+		    addr, len);
 
+		res = s3c2410_dma_enqueue(host->dma, host, addr, len);
 		if (res) {
 			s3c2410_dma_ctrl(host->dma, S3C2410_DMAOP_FLUSH);
+			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len,
+				     rw ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
 			return -EBUSY;
 		}
+
+		if (i < dma_len) {
+			addr = sg_dma_address(&data->sg[i]);
+			len = sg_dma_len(&data->sg[i]);
+		}
 	}
 
 	s3c2410_dma_ctrl(host->dma, S3C2410_DMAOP_START);
@@ -1194,6 +1273,7 @@ static void s3cmci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	host->status = "mmc request";
 	host->cmd_is_stop = 0;
 	host->mrq = mrq;
+	host->req_start = ktime_get();
 
 	if (s3cmci_card_present(mmc) == 0) {
 		dbg(host, dbg_err, "%s: no medium present\n", __func__);
@@ -1456,6 +1536,54 @@ static const struct file_operations s3cmci_fops_state = {
 	.release	= single_release,
 };
 
+static void s3cmci_show_stats(struct seq_file *seq, const char *name,
+			      struct s3cmci_stats *stats)
+{
+	u64 kbps = 0;
+	int i;
+
+	if (stats->usecs)
+		kbps = div64_u64(stats->bytes * 1000000, stats->usecs * 1024);
+
+	seq_printf(seq, "%s:\t%lu reqs, %llu bytes, %llu us, %llu KiB/s, "
+		   "%lu segments, %lu errors\n", name, stats->requests,
+		   (unsigned long long)stats->bytes,
+		   (unsigned long long)stats->usecs,
+		   (unsigned long long)kbps, stats->segments, stats->errors);
+
+	for (i = 0; i < S3CMCI_LAT_BUCKETS; i++) {
+		if (i == S3CMCI_LAT_BUCKETS - 1)
+			seq_printf(seq, "\t  >= %6u us: %lu\n",
+				   64 << i, stats->latency[i]);
+		else
+			seq_printf(seq, "\t   < %6u us: %lu\n",
+				   128 << i, stats->latency[i]);
+	}
+}
+
+static int s3cmci_stats_show(struct seq_file *seq, void *v)
+{
+	struct s3cmci_host *host = seq->private;
+
+	s3cmci_show_stats(seq, "read", &host->stats[0]);
+	s3cmci_show_stats(seq, "write", &host->stats[1]);
+
+	return 0;
+}
+
+static int s3cmci_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, s3cmci_stats_show, inode->i_private);
+}
+
+static const struct file_operations s3cmci_fops_stats = {
+	.owner		= THIS_MODULE,
+	.open		= s3cmci_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 #define DBG_REG(_r) { .addr = S3C2410_SDI##_r, .name = #_r }
 
 struct s3cmci_reg {
@@ -1530,10 +1658,18 @@ static void s3cmci_debugfs_attach(struct s3cmci_host *host)
 
 	if (IS_ERR(host->debug_regs))
 		dev_err(dev, "failed to create debug regs file\n");
+
+	host->debug_stats = debugfs_create_file("stats", 0444,
+						host->debug_root, host,
+						&s3cmci_fops_stats);
+
+	if (IS_ERR(host->debug_stats))
+		dev_err(dev, "failed to create debug stats file\n");
 }
 
 static void s3cmci_debugfs_remove(struct s3cmci_host *host)
 {
+	debugfs_remove(host->debug_stats);
 	debugfs_remove(host->debug_regs);
 	debugfs_remove(host->debug_state);
 	debugfs_remove(host->debug_root);
@@ -1601,7 +1737,7 @@ static int __devinit s3cmci_probe(struct platform_device *pdev)
 	host->pio_active 	= XFER_NONE;
 
 #ifdef CONFIG_MMC_S3C_PIODMA
-	host->dodma		= host->pdata->dma;
+	host->dodma		= host->pdata->use_dma;
 #endif
 
 	host->mem = platform_get_resource(pdev, IORESOURCE_MEM, 0);
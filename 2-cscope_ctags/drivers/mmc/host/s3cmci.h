@@ -17,6 +17,26 @@ enum s3cmci_waitfor {
 	COMPLETION_XFERFINISH_RSPFIN,
 };
 
+#define S3CMCI_LAT_BUCKETS	12	/* < 128us, < 256us, ... >= 128ms */
+
+/**
+ * struct s3cmci_stats - data transfer statistics, see debugfs "stats".
+ * @requests: Data requests completed without error.
+ * @bytes: Bytes moved by those requests.
+ * @usecs: Time from s3cmci_request() to completion, summed.
+ * @segments: DMA buffers queued, after merging contiguous sg entries.
+ * @errors: Data requests that failed.
+ * @latency: Histogram of request latency in power of two buckets.
+ */
+struct s3cmci_stats {
+	unsigned long		requests;
+	u64			bytes;
+	u64			usecs;
+	unsigned long		segments;
+	unsigned long		errors;
+	unsigned long		latency[S3CMCI_LAT_BUCKETS];
+};
+
 struct s3cmci_host {
 	struct platform_device	*pdev;
 	struct s3c24xx_mci_pdata *pdata;
@@ -70,10 +90,14 @@ struct s3cmci_host {
 	unsigned int		ccnt, dcnt;
 	struct tasklet_struct	pio_tasklet;
 
+	ktime_t			req_start;
+	struct s3cmci_stats	stats[2];	/* indexed by MMC_DATA_WRITE != 0 */
+
 #ifdef CONFIG_DEBUG_FS
 	struct dentry		*debug_root;
 	struct dentry		*debug_state;
 	struct dentry		*debug_regs;
+	struct dentry		*debug_stats;
 #endif
 
 #ifdef CONFIG_CPU_FREQ
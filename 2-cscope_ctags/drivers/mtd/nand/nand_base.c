@@ -19,7 +19,6 @@
  *	rework for 2K page size chips
  *
  *  TODO:
- *	Enable cached programming for 2k page size chips
  *	Check, if mtd->ecctype should be set to MTD_ECC_HW
  *	if we have HW ecc support.
  *	The AG-AND chips have nice features for speed improvement,
@@ -756,6 +755,27 @@ static int nand_wait(struct mtd_info *mtd, struct nand_chip *chip)
 	return status;
 }
 
+/**
+ * nand_wait_true_ready - [Internal] wait until the array is idle
+ * @mtd:	MTD device structure
+ * @chip:	NAND chip structure
+ *
+ * During cache programming the ready/busy line only tells that the cache
+ * register is free. Poll the status until the programming of the array has
+ * finished too, so an aborted sequence does not leave the chip busy.
+ */
+static void nand_wait_true_ready(struct mtd_info *mtd, struct nand_chip *chip)
+{
+	unsigned long timeo = jiffies + (HZ * 20) / 1000;
+
+	chip->cmdfunc(mtd, NAND_CMD_STATUS, -1, -1);
+	while (time_before(jiffies, timeo)) {
+		if (chip->read_byte(mtd) & NAND_STATUS_TRUE_READY)
+			break;
+		cond_resched();
+	}
+}
+
 /**
  * nand_read_page_raw - [Intern] read raw page data without ecc
  * @mtd:	mtd info structure
@@ -1151,6 +1171,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	struct mtd_ecc_stats stats;
 	int blkcheck = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
 	int sndcmd = 1;
+	int cacheread, incache = 0, more;
 	int ret = 0;
 	uint32_t readlen = ops->len;
 	uint32_t oobreadlen = ops->ooblen;
@@ -1169,17 +1190,46 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	buf = ops->datbuf;
 	oob = ops->oobbuf;
 
+	/*
+	 * Sequential reads can use the read cache: the chip loads the next
+	 * page while the current one is transferred. The board driver has to
+	 * ask for it, only our own command function knows the commands, and
+	 * the page must be read out in one go, without column changes, which
+	 * only our own read_page functions guarantee.
+	 */
+	cacheread = NAND_HAS_CACHERD(chip) && chip->cmdfunc == nand_command_lp &&
+		(chip->ecc.read_page == nand_read_page_raw ||
+		 chip->ecc.read_page == nand_read_page_swecc ||
+		 chip->ecc.read_page == nand_read_page_hwecc ||
+		 chip->ecc.read_page == nand_read_page_syndrome) &&
+		(chip->ecc.read_page_raw == nand_read_page_raw ||
+		 chip->ecc.read_page_raw == nand_read_page_raw_syndrome);
+
 	while(1) {
 		bytes = min(mtd->writesize - col, readlen);
 		aligned = (bytes == mtd->writesize);
 
 		/* Is the current page in the buffer ? */
-		if (realpage != chip->pagebuf || oob) {
+		if (realpage != chip->pagebuf || oob || incache) {
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
-			if (likely(sndcmd)) {
+			/* Is the next page of this block needed as well ? */
+			more = cacheread && aligned && readlen > bytes &&
+				(page & blkcheck) != blkcheck;
+
+			if (incache) {
+				/* This page was loaded during the last transfer */
+				chip->cmdfunc(mtd, more ? NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND, -1, -1);
+				incache = more;
+			} else if (likely(sndcmd)) {
 				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
 				sndcmd = 0;
+				if (more) {
+					chip->cmdfunc(mtd, NAND_CMD_READCACHESEQ,
+						      -1, -1);
+					incache = 1;
+				}
 			}
 
 			/* Now read the page into the buffer */
@@ -1191,8 +1241,13 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 			else
 				ret = chip->ecc.read_page(mtd, chip, bufpoi,
 							  page);
-			if (ret < 0)
+			if (ret < 0) {
+				if (incache)
+					chip->cmdfunc(mtd,
+						      NAND_CMD_READCACHEEND,
+						      -1, -1);
 				break;
+			}
 
 			/* Transfer not aligned data */
 			if (!aligned) {
@@ -1761,13 +1816,12 @@ static int nand_write_page(struct mtd_info *mtd, struct nand_chip *chip,
 	else
 		chip->ecc.write_page(mtd, chip, buf);
 
-	/*
-	 * Cached progamming disabled for now, Not sure if its worth the
-	 * trouble. The speed gain is not very impressive. (2.3->2.6Mib/s)
-	 */
+#ifdef CONFIG_MTD_NAND_VERIFY_WRITE
+	/* The page is read back below, it must be programmed by then */
 	cached = 0;
+#endif
 
-	if (!cached || !(chip->options & NAND_CACHEPRG)) {
+	if (!cached || !NAND_HAS_CACHEPROG(chip)) {
 
 		chip->cmdfunc(mtd, NAND_CMD_PAGEPROG, -1, -1);
 		status = chip->waitfunc(mtd, chip);
@@ -1779,11 +1833,33 @@ static int nand_write_page(struct mtd_info *mtd, struct nand_chip *chip,
 			status = chip->errstat(mtd, chip, FL_WRITING, status,
 					       page);
 
+		/*
+		 * The last page of a cache program sequence also reports
+		 * the result of the page before it
+		 */
+		if (chip->state == FL_CACHEDPRG) {
+			chip->state = FL_WRITING;
+			if (status & NAND_STATUS_FAIL_N1)
+				return -EIO;
+		}
+
 		if (status & NAND_STATUS_FAIL)
 			return -EIO;
 	} else {
+		/*
+		 * The chip takes the next page into its cache register while
+		 * this one is programmed. Ready only means the cache register
+		 * is free again, the status tells about the previous page.
+		 */
 		chip->cmdfunc(mtd, NAND_CMD_CACHEDPROG, -1, -1);
 		status = chip->waitfunc(mtd, chip);
+		if (chip->state == FL_CACHEDPRG &&
+		    (status & NAND_STATUS_FAIL_N1)) {
+			nand_wait_true_ready(mtd, chip);
+			chip->state = FL_WRITING;
+			return -EIO;
+		}
+		chip->state = FL_CACHEDPRG;
 	}
 
 #ifdef CONFIG_MTD_NAND_VERIFY_WRITE
@@ -1904,7 +1980,8 @@ static int nand_do_write_ops(struct mtd_info *mtd, loff_t to,
 
 	while(1) {
 		int bytes = mtd->writesize;
-		int cached = writelen > bytes && page != blockmask;
+		int cached = writelen > bytes &&
+			(page & blockmask) != blockmask;
 		uint8_t *wbuf = buf;
 
 		/* Partial page write ? */
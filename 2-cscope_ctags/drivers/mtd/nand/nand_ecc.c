@@ -57,6 +57,9 @@ struct mtd_info;
 
 #define printk printf
 #define KERN_ERR		""
+#ifndef __always_inline
+#define __always_inline		inline __attribute__((always_inline))
+#endif
 #endif
 
 /*
@@ -149,30 +152,92 @@ static const char addressbits[256] = {
 	0x0e, 0x0e, 0x0f, 0x0f, 0x0e, 0x0e, 0x0f, 0x0f
 };
 
-/**
- * nand_calculate_ecc - [NAND Interface] Calculate 3-byte ECC for 256/512-byte
- *			 block
- * @mtd:	MTD block structure
- * @buf:	input buffer with raw data
- * @code:	output buffer with ECC
+/*
+ * NAND_ECC_BLOCK processes 16 longwords (64 bytes) of data: it updates rp4,
+ * rp6, rp8 and rp10 and leaves the parity of the 64 bytes in tmppar.
+ * It is a macro so that all the accumulators stay in registers; with 16
+ * registers on ARM there are barely enough of them.
  */
-int nand_calculate_ecc(struct mtd_info *mtd, const unsigned char *buf,
-		       unsigned char *code)
+#define NAND_ECC_BLOCK()				\
+do {							\
+	cur = *bp++;					\
+	tmppar = cur;					\
+	rp4 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp6 ^= tmppar;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp4 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp8 ^= tmppar;					\
+							\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp4 ^= cur;					\
+	rp6 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp6 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp4 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp10 ^= tmppar;					\
+							\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp4 ^= cur;					\
+	rp6 ^= cur;					\
+	rp8 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp6 ^= cur;					\
+	rp8 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp4 ^= cur;					\
+	rp8 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp8 ^= cur;					\
+							\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp4 ^= cur;					\
+	rp6 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp6 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+	rp4 ^= cur;					\
+	cur = *bp++;					\
+	tmppar ^= cur;					\
+} while (0)
+
+/*
+ * nand_ecc_calc - calculate the ECC, @eccsize_mult is 1 for 256-byte and 2 for
+ * 512-byte blocks. It is always inlined with a constant @eccsize_mult, which
+ * gives a separate copy of the code per block size, so that neither
+ * @eccsize_mult nor rp16 occupy a register when they are not needed.
+ */
+static __always_inline void nand_ecc_calc(const unsigned char *buf,
+					  const uint32_t eccsize_mult,
+					  unsigned char *code)
 {
 	int i;
 	const uint32_t *bp = (uint32_t *)buf;
-	/* 256 or 512 bytes/ecc  */
-	const uint32_t eccsize_mult =
-			(((struct nand_chip *)mtd->priv)->ecc.size) >> 8;
 	uint32_t cur;		/* current value in buffer */
 	/* rp0..rp15..rp17 are the various accumulated parities (per byte) */
 	uint32_t rp0, rp1, rp2, rp3, rp4, rp5, rp6, rp7;
 	uint32_t rp8, rp9, rp10, rp11, rp12, rp13, rp14, rp15, rp16;
 	uint32_t uninitialized_var(rp17);	/* to make compiler happy */
 	uint32_t par;		/* the cumulative parity for all data */
-	uint32_t tmppar;	/* the cumulative parity for this iteration;
-				   for rp12, rp14 and rp16 at the end of the
-				   loop */
+	uint32_t tmppar;	/* the cumulative parity for this block;
+				   for rp12, rp14, rp16 and par */
 
 	par = 0;
 	rp4 = 0;
@@ -189,74 +254,27 @@ int nand_calculate_ecc(struct mtd_info *mtd, const unsigned char *buf,
 	 * Also we process the data by longwords.
 	 * Note: passing unaligned data might give a performance penalty.
 	 * It is assumed that the buffers are aligned.
-	 * tmppar is the cumulative sum of this iteration.
+	 * tmppar is the cumulative sum of a 64-byte block.
 	 * needed for calculating rp12, rp14, rp16 and par
 	 * also used as a performance improvement for rp6, rp8 and rp10
+	 * Each iteration does two blocks: the first one always goes to rp12
+	 * and the second one never does, so rp12 needs no test, and rp14 and
+	 * rp16 are tested on the iteration count.
 	 */
-	for (i = 0; i < eccsize_mult << 2; i++) {
-		cur = *bp++;
-		tmppar = cur;
-		rp4 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= tmppar;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp4 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp8 ^= tmppar;
-
-		cur = *bp++;
-		tmppar ^= cur;
-		rp4 ^= cur;
-		rp6 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp4 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp10 ^= tmppar;
-
-		cur = *bp++;
-		tmppar ^= cur;
-		rp4 ^= cur;
-		rp6 ^= cur;
-		rp8 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= cur;
-		rp8 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp4 ^= cur;
-		rp8 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp8 ^= cur;
-
-		cur = *bp++;
-		tmppar ^= cur;
-		rp4 ^= cur;
-		rp6 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp6 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
-		rp4 ^= cur;
-		cur = *bp++;
-		tmppar ^= cur;
+	for (i = 0; i < eccsize_mult << 1; i++) {
+		NAND_ECC_BLOCK();
+		par ^= tmppar;
+		rp12 ^= tmppar;
+		if ((i & 0x1) == 0)
+			rp14 ^= tmppar;
+		if (eccsize_mult == 2 && (i & 0x2) == 0)
+			rp16 ^= tmppar;
 
+		NAND_ECC_BLOCK();
 		par ^= tmppar;
 		if ((i & 0x1) == 0)
-			rp12 ^= tmppar;
-		if ((i & 0x2) == 0)
 			rp14 ^= tmppar;
-		if (eccsize_mult == 2 && (i & 0x4) == 0)
+		if (eccsize_mult == 2 && (i & 0x2) == 0)
 			rp16 ^= tmppar;
 	}
 
@@ -412,6 +430,37 @@ int nand_calculate_ecc(struct mtd_info *mtd, const unsigned char *buf,
 		    (invparity[par & 0x55] << 2) |
 		    (invparity[rp17] << 1) |
 		    (invparity[rp16] << 0);
+}
+
+/**
+ * __nand_calculate_ecc - [NAND Interface] Calculate 3-byte ECC for 256/512-byte
+ *			 block
+ * @buf:	input buffer with raw data
+ * @eccsize:	data bytes per ecc step (256 or 512)
+ * @code:	output buffer with ECC
+ */
+void __nand_calculate_ecc(const unsigned char *buf, unsigned int eccsize,
+			  unsigned char *code)
+{
+	if (eccsize == 512)
+		nand_ecc_calc(buf, 2, code);
+	else
+		nand_ecc_calc(buf, 1, code);
+}
+EXPORT_SYMBOL(__nand_calculate_ecc);
+
+/**
+ * nand_calculate_ecc - [NAND Interface] Calculate 3-byte ECC for 256/512-byte
+ *			 block
+ * @mtd:	MTD block structure
+ * @buf:	input buffer with raw data
+ * @code:	output buffer with ECC
+ */
+int nand_calculate_ecc(struct mtd_info *mtd, const unsigned char *buf,
+		       unsigned char *code)
+{
+	__nand_calculate_ecc(buf, ((struct nand_chip *)mtd->priv)->ecc.size,
+			     code);
 	return 0;
 }
 EXPORT_SYMBOL(nand_calculate_ecc);
@@ -431,6 +480,7 @@ int __nand_correct_data(unsigned char *buf,
 {
 	unsigned char b0, b1, b2, bit_addr;
 	unsigned int byte_addr;
+	uint32_t b, mask;
 	/* 256 or 512 bytes/ecc  */
 	const uint32_t eccsize_mult = eccsize >> 8;
 
@@ -456,10 +506,15 @@ int __nand_correct_data(unsigned char *buf,
 	if ((b0 | b1 | b2) == 0)
 		return 0;	/* no error */
 
-	if ((((b0 ^ (b0 >> 1)) & 0x55) == 0x55) &&
-	    (((b1 ^ (b1 >> 1)) & 0x55) == 0x55) &&
-	    ((eccsize_mult == 1 && ((b2 ^ (b2 >> 1)) & 0x54) == 0x54) ||
-	     (eccsize_mult == 2 && ((b2 ^ (b2 >> 1)) & 0x55) == 0x55))) {
+	/*
+	 * For a single bit error, every bit pair of the xor-ed ecc has
+	 * exactly one bit set. All three bytes are checked at once: the shift
+	 * moves the lowest bit of b1 and b2 into bit 7 of the byte below,
+	 * which is not part of the mask.
+	 */
+	b = (b2 << 16) | (b1 << 8) | b0;
+	mask = eccsize_mult == 1 ? 0x545555 : 0x555555;
+	if (((b ^ (b >> 1)) & mask) == mask) {
 	/* single bit error */
 		/*
 		 * rp17/rp15/13/11/9/7/5/3/1 indicate which byte is the faulty
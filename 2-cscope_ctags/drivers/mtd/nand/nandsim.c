@@ -188,7 +188,8 @@ MODULE_PARM_DESC(cache_file,     "File to use to cache nand pages instead of mem
 #define NS_IS_INITIALIZED(ns) ((ns)->geom.totsz != 0)
 
 /* Good operation completion status */
-#define NS_STATUS_OK(ns) (NAND_STATUS_READY | (NAND_STATUS_WP * ((ns)->lines.wp == 0)))
+#define NS_STATUS_OK(ns) (NAND_STATUS_READY | NAND_STATUS_TRUE_READY | \
+			  (NAND_STATUS_WP * ((ns)->lines.wp == 0)))
 
 /* Operation failed completion status */
 #define NS_STATUS_FAILED(ns) (NAND_STATUS_FAIL | NS_STATUS_OK(ns))
@@ -354,6 +355,10 @@ struct nandsim {
 	void *file_buf;
 	struct page *held_pages[NS_MAX_HELD_PAGES];
 	int held_cnt;
+
+	/* Read cache state */
+	int cache_read;         /* the next page is being loaded by a cache read */
+	uint cache_row;         /* the page being loaded */
 };
 
 /*
@@ -408,6 +413,9 @@ struct weak_block {
 	unsigned int erases_done;
 };
 
+/* States of a cache read (large page devices), the page is output only */
+static uint32_t read_cache_states[NS_OPER_STATES] = {STATE_DATAOUT, STATE_READY};
+
 static LIST_HEAD(weak_blocks);
 
 struct weak_page {
@@ -1071,6 +1079,7 @@ static int check_command(int cmd)
 	case NAND_CMD_RESET:
 	case NAND_CMD_RNDOUT:
 	case NAND_CMD_RNDOUTSTART:
+	case NAND_CMD_CACHEDPROG:
 		return 0;
 
 	case NAND_CMD_STATUS_MULTI:
@@ -1090,6 +1099,8 @@ static uint32_t get_state_by_command(unsigned command)
 		case NAND_CMD_READ1:
 			return STATE_CMD_READ1;
 		case NAND_CMD_PAGEPROG:
+		case NAND_CMD_CACHEDPROG:
+			/* Pages are programmed instantly, no cache is needed */
 			return STATE_CMD_PAGEPROG;
 		case NAND_CMD_READSTART:
 			return STATE_CMD_READSTART;
@@ -1942,6 +1953,55 @@ static u_char ns_nand_read_byte(struct mtd_info *mtd)
 	return outb;
 }
 
+/*
+ * Large page read cache. The first 31h after a page read outputs that page
+ * and starts loading the next one, every further 31h outputs the loaded page
+ * and starts loading the one after it, 3Fh outputs the loaded page and ends
+ * the sequence. Pages load instantly here, so a page is simply copied to the
+ * buffer when it is output.
+ */
+static void read_cache(struct nandsim *ns, u_char cmd)
+{
+	uint row;
+
+	if (!(ns->options & OPT_LARGEPAGE)) {
+		NS_ERR("write_byte: unknown command %#x\n", (uint)cmd);
+		return;
+	}
+
+	if (ns->cache_read)
+		row = ns->cache_row;
+	else if (NS_STATE(ns->state) == STATE_DATAOUT &&
+		 ns->regs.command == NAND_CMD_READSTART)
+		row = ns->regs.row;
+	else {
+		NS_ERR("read_cache: no page read in progress, ignore command %#x\n",
+			(uint)cmd);
+		switch_to_ready_state(ns, NS_STATUS_FAILED(ns));
+		return;
+	}
+
+	switch_to_ready_state(ns, NS_STATUS_OK(ns));
+	ns->cache_read = 0;
+	ns->regs.row = row;
+	if (do_state_action(ns, ACTION_CPY) < 0) {
+		switch_to_ready_state(ns, NS_STATUS_FAILED(ns));
+		return;
+	}
+
+	NS_DBG("read_cache: output page %#x\n", row);
+	ns->regs.command = cmd;
+	ns->op = &read_cache_states[0];
+	ns->state = STATE_DATAOUT;
+	ns->nxstate = ns->op[1];
+	ns->regs.num = ns->geom.pgszoob;
+
+	if (cmd == NAND_CMD_READCACHESEQ && row + 1 < ns->geom.pgnum) {
+		ns->cache_read = 1;
+		ns->cache_row = row + 1;
+	}
+}
+
 static void ns_nand_write_byte(struct mtd_info *mtd, u_char byte)
 {
         struct nandsim *ns = (struct nandsim *)((struct nand_chip *)mtd->priv)->priv;
@@ -1961,6 +2021,13 @@ static void ns_nand_write_byte(struct mtd_info *mtd, u_char byte)
 		 * The byte written is a command.
 		 */
 
+		if (byte == NAND_CMD_READCACHESEQ ||
+		    byte == NAND_CMD_READCACHEEND) {
+			read_cache(ns, byte);
+			return;
+		}
+		ns->cache_read = 0;
+
 		if (byte == NAND_CMD_RESET) {
 			NS_LOG("reset chip\n");
 			switch_to_ready_state(ns, NS_STATUS_OK(ns));
@@ -2257,6 +2324,8 @@ static int __init ns_init_module(void)
 	/* The NAND_SKIP_BBTSCAN option is necessary for 'overridesize' */
 	/* and 'badblocks' parameters to work */
 	chip->options   |= NAND_SKIP_BBTSCAN;
+	/* Large page chips emulate the read cache, see read_cache() */
+	chip->options   |= NAND_CACHERD;
 
 	/*
 	 * Perform minimum nandsim structure initialization to handle
@@ -37,6 +37,13 @@
 #include <linux/slab.h>
 #include <linux/clk.h>
 #include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/dma-mapping.h>
+#include <linux/cache.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/nand.h>
@@ -48,6 +55,10 @@
 #include <plat/regs-nand.h>
 #include <plat/nand.h>
 
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+#include <mach/dma.h>
+#endif
+
 #ifdef CONFIG_MTD_NAND_S3C2410_HWECC
 static int hardware_ecc = 1;
 #else
@@ -60,6 +71,20 @@ static int clock_stop = 1;
 static const int clock_stop = 0;
 #endif
 
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+static int use_dma = 1;
+module_param(use_dma, int, 0644);
+MODULE_PARM_DESC(use_dma, "use DMA for full page transfers (S3C2440 only)");
+
+/* transfers shorter than one ECC step of a large page chip, such as
+ * OOB reads, always use PIO */
+#define S3C2440_NAND_DMA_MIN	256
+
+static struct s3c2410_dma_client s3c2440_nand_dma_client = {
+	.name		= "s3c2440-nand",
+};
+#endif
+
 
 /* new oob placement block for use with hardware ecc generation
  */
@@ -96,6 +121,34 @@ enum s3c_cpu_type {
 	TYPE_S3C2440,
 };
 
+/**
+ * struct s3c2410_nand_xfer_stats - data transfer accounting.
+ * @count: The number of transfers made.
+ * @bytes: The number of bytes moved.
+ * @usecs: The time spent moving them, in microseconds.
+ */
+struct s3c2410_nand_xfer_stats {
+	unsigned long			count;
+	u64				bytes;
+	u64				usecs;
+};
+
+/**
+ * struct s3c2410_nand_stats - data transfer statistics, see debugfs.
+ * @dma_read: Page reads done by DMA.
+ * @dma_write: Page writes done by DMA.
+ * @pio_read: Reads done by programmed I/O.
+ * @pio_write: Writes done by programmed I/O.
+ * @dma_errors: The number of DMA transfers which failed or timed out.
+ */
+struct s3c2410_nand_stats {
+	struct s3c2410_nand_xfer_stats	dma_read;
+	struct s3c2410_nand_xfer_stats	dma_write;
+	struct s3c2410_nand_xfer_stats	pio_read;
+	struct s3c2410_nand_xfer_stats	pio_write;
+	unsigned long			dma_errors;
+};
+
 /* overview of the s3c2410 nand state */
 
 /**
@@ -112,6 +165,15 @@ enum s3c_cpu_type {
  * @save_sel: The contents of @sel_reg to be saved over suspend.
  * @clk_rate: The clock rate from @clk.
  * @cpu_type: The exact type of this controller.
+ * @dma: The DMA channel used for page transfers, or -1 for PIO only.
+ * @dma_done: Completion signalled by the DMA buffer done callback.
+ * @dma_result: The result passed to the DMA buffer done callback.
+ * @dma_addr: The bus address of the transfer in flight.
+ * @dma_len: The length of the transfer in flight.
+ * @dma_dir: The direction of the transfer in flight.
+ * @stats: The data transfer statistics.
+ * @debug_root: The debugfs directory for this controller.
+ * @debug_stats: The debugfs file showing @stats.
  */
 struct s3c2410_nand_info {
 	/* mtd info */
@@ -132,6 +194,22 @@ struct s3c2410_nand_info {
 
 	enum s3c_cpu_type		cpu_type;
 
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+	int				dma;
+	struct completion		dma_done;
+	enum s3c2410_dma_buffresult	dma_result;
+	dma_addr_t			dma_addr;
+	int				dma_len;
+	enum dma_data_direction		dma_dir;
+#endif
+
+	struct s3c2410_nand_stats	stats;
+
+#ifdef CONFIG_DEBUG_FS
+	struct dentry			*debug_root;
+	struct dentry			*debug_stats;
+#endif
+
 #ifdef CONFIG_CPU_FREQ
 	struct notifier_block	freq_transition;
 #endif
@@ -570,6 +648,207 @@ static int s3c2440_nand_calculate_ecc(struct mtd_info *mtd, const u_char *dat, u
 	return 0;
 }
 
+/* data transfer accounting */
+
+static void s3c2410_nand_account(struct s3c2410_nand_xfer_stats *stats,
+				 int len, ktime_t start)
+{
+	stats->count++;
+	stats->bytes += len;
+	stats->usecs += ktime_us_delta(ktime_get(), start);
+}
+
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+
+/* DMA support
+ *
+ * The NAND controller has no DMA request line, so the transfer is run
+ * as a software triggered whole service transfer to or from NFDATA.
+ * Each access made by the DMA engine generates the nRE/nWE cycles just
+ * as the readsl/writesl PIO path does.
+*/
+
+static void s3c2440_nand_dma_done(struct s3c2410_dma_chan *chan, void *buf_id,
+				  int size, enum s3c2410_dma_buffresult result)
+{
+	struct s3c2410_nand_info *info = buf_id;
+
+	info->dma_result = result;
+	complete(&info->dma_done);
+}
+
+/**
+ * s3c2440_nand_can_dma - check if a transfer can be done by DMA
+ * @info: The controller instance.
+ * @buf: The buffer to transfer to or from.
+ * @len: The length of the transfer.
+ * @dir: The direction of the transfer.
+ *
+ * The buffer must be in the kernel's linear mapping, since the buffers
+ * handed down by UBI or JFFS2 may be vmalloc()ed, and word aligned for
+ * the channel's word transfers. A buffer read into must also cover whole
+ * cache lines: the ARM920T's dma_unmap_single() does no cache maintenance,
+ * so a line shared with other data that the CPU touches while the DMA runs
+ * would leave stale data in the buffer, or be written back over it.
+ */
+static int s3c2440_nand_can_dma(struct s3c2410_nand_info *info,
+				const void *buf, int len,
+				enum dma_data_direction dir)
+{
+	int align = (dir == DMA_FROM_DEVICE) ? L1_CACHE_BYTES : 4;
+
+	if (!use_dma || info->dma < 0 || in_interrupt())
+		return 0;
+
+	if (len < S3C2440_NAND_DMA_MIN || !IS_ALIGNED(len, align) ||
+	    !IS_ALIGNED((unsigned long)buf, align))
+		return 0;
+
+	return virt_addr_valid(buf) && virt_addr_valid(buf + len - 1);
+}
+
+/**
+ * s3c2440_nand_dma_submit - start transferring a buffer by DMA
+ * @info: The controller instance.
+ * @buf: The buffer to transfer to or from.
+ * @len: The length of the transfer.
+ * @dir: The direction of the transfer.
+ *
+ * Returns -EAGAIN if the transfer could not be started, in which case
+ * the caller should fall back to PIO. Otherwise the caller must finish
+ * the transfer with s3c2440_nand_dma_wait(), and move whatever it did not
+ * transfer by PIO.
+ */
+static int s3c2440_nand_dma_submit(struct s3c2410_nand_info *info,
+				   void *buf, int len,
+				   enum dma_data_direction dir)
+{
+	enum s3c2410_dmasrc source;
+
+	source = (dir == DMA_FROM_DEVICE) ? S3C2410_DMASRC_HW : S3C2410_DMASRC_MEM;
+
+	info->dma_addr = dma_map_single(info->device, buf, len, dir);
+	info->dma_len = len;
+	info->dma_dir = dir;
+
+	s3c2410_dma_devconfig(info->dma, source,
+			      info->area->start + S3C2440_NFDATA);
+
+	INIT_COMPLETION(info->dma_done);
+
+	if (s3c2410_dma_enqueue(info->dma, info, info->dma_addr, len) < 0) {
+		dma_unmap_single(info->device, info->dma_addr, len, dir);
+		return -EAGAIN;
+	}
+
+	s3c2410_dma_ctrl(info->dma, S3C2410_DMAOP_START);
+	return 0;
+}
+
+/**
+ * s3c2440_nand_dma_wait - wait for a DMA transfer to finish
+ * @info: The controller instance.
+ *
+ * Returns the number of bytes transferred. This is less than the length
+ * submitted if the transfer timed out or failed part way through, in
+ * which case the caller has to move the rest by PIO. The NAND data
+ * register is a FIFO, so the PIO transfer simply carries on from where
+ * the DMA stopped.
+ */
+static int s3c2440_nand_dma_wait(struct s3c2410_nand_info *info)
+{
+	dma_addr_t src, dst, pos;
+	int done = info->dma_len;
+
+	if (!wait_for_completion_timeout(&info->dma_done,
+					 msecs_to_jiffies(100))) {
+		dev_err(info->device, "timeout waiting for DMA\n");
+		s3c2410_dma_ctrl(info->dma, S3C2410_DMAOP_FLUSH);
+		done = -1;
+	} else if (info->dma_result != S3C2410_RES_OK) {
+		dev_err(info->device, "DMA failed (%d)\n", info->dma_result);
+		done = -1;
+	}
+
+	if (done < 0) {
+		info->stats.dma_errors++;
+
+		/* find out how far the channel got, in whole words */
+		done = 0;
+		if (s3c2410_dma_getposition(info->dma, &src, &dst) == 0) {
+			pos = (info->dma_dir == DMA_FROM_DEVICE) ? dst : src;
+			if (pos > info->dma_addr &&
+			    pos <= info->dma_addr + info->dma_len)
+				done = (pos - info->dma_addr) & ~3;
+		}
+	}
+
+	dma_unmap_single(info->device, info->dma_addr, info->dma_len,
+			 info->dma_dir);
+	return done;
+}
+
+static int s3c2440_nand_dma_init(struct s3c2410_nand_info *info)
+{
+	info->dma = -1;
+
+	if (!use_dma || info->cpu_type != TYPE_S3C2440)
+		return 0;
+
+	init_completion(&info->dma_done);
+
+	info->dma = s3c2410_dma_request(DMACH_NAND, &s3c2440_nand_dma_client,
+					NULL);
+	if (info->dma < 0) {
+		dev_warn(info->device, "cannot get DMA channel, using PIO\n");
+		info->dma = -1;
+		return 0;
+	}
+
+	s3c2410_dma_config(info->dma, 4);
+	s3c2410_dma_set_buffdone_fn(info->dma, s3c2440_nand_dma_done);
+
+	dev_info(info->device, "using DMA channel %d for page transfers\n",
+		 info->dma & ~DMACH_LOW_LEVEL);
+
+	return 0;
+}
+
+static void s3c2440_nand_dma_exit(struct s3c2410_nand_info *info)
+{
+	if (info->dma >= 0)
+		s3c2410_dma_free(info->dma, &s3c2440_nand_dma_client);
+	info->dma = -1;
+}
+
+#else
+static inline int s3c2440_nand_can_dma(struct s3c2410_nand_info *info,
+				       const void *buf, int len,
+				       enum dma_data_direction dir)
+{
+	return 0;
+}
+
+static inline int s3c2440_nand_dma_submit(struct s3c2410_nand_info *info,
+					  void *buf, int len,
+					  enum dma_data_direction dir)
+{
+	return -EAGAIN;
+}
+
+static inline int s3c2440_nand_dma_wait(struct s3c2410_nand_info *info)
+{
+	return 0;	/* nothing transferred */
+}
+
+static inline int s3c2440_nand_dma_init(struct s3c2410_nand_info *info)
+{
+	return 0;
+}
+
+static inline void s3c2440_nand_dma_exit(struct s3c2410_nand_info *info) { }
+#endif /* CONFIG_MTD_NAND_S3C2410_DMA */
+
 /* over-ride the standard functions for a little more speed. We can
  * use read/write block to move the data buffers to/from the controller
 */
@@ -580,10 +859,9 @@ static void s3c2410_nand_read_buf(struct mtd_info *mtd, u_char *buf, int len)
 	readsb(this->IO_ADDR_R, buf, len);
 }
 
-static void s3c2440_nand_read_buf(struct mtd_info *mtd, u_char *buf, int len)
+static void s3c2440_nand_read_pio(struct s3c2410_nand_info *info,
+				  u_char *buf, int len)
 {
-	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
-
 	readsl(info->regs + S3C2440_NFDATA, buf, len >> 2);
 
 	/* cleanup if we've got less than a word to do */
@@ -595,6 +873,30 @@ static void s3c2440_nand_read_buf(struct mtd_info *mtd, u_char *buf, int len)
 	}
 }
 
+static void s3c2440_nand_read_buf(struct mtd_info *mtd, u_char *buf, int len)
+{
+	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+	ktime_t start = ktime_get();
+
+	int done;
+
+	if (s3c2440_nand_can_dma(info, buf, len, DMA_FROM_DEVICE) &&
+	    s3c2440_nand_dma_submit(info, buf, len, DMA_FROM_DEVICE) == 0) {
+		done = s3c2440_nand_dma_wait(info);
+		s3c2410_nand_account(&info->stats.dma_read, done, start);
+		if (done == len)
+			return;
+
+		/* the DMA failed, read the rest of the buffer by PIO */
+		buf += done;
+		len -= done;
+		start = ktime_get();
+	}
+
+	s3c2440_nand_read_pio(info, buf, len);
+	s3c2410_nand_account(&info->stats.pio_read, len, start);
+}
+
 static void s3c2410_nand_write_buf(struct mtd_info *mtd, const u_char *buf, int len)
 {
 	struct nand_chip *this = mtd->priv;
@@ -604,16 +906,162 @@ static void s3c2410_nand_write_buf(struct mtd_info *mtd, const u_char *buf, int
 static void s3c2440_nand_write_buf(struct mtd_info *mtd, const u_char *buf, int len)
 {
 	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+	ktime_t start = ktime_get();
+
+	int done;
+
+	if (s3c2440_nand_can_dma(info, buf, len, DMA_TO_DEVICE) &&
+	    s3c2440_nand_dma_submit(info, (void *)buf, len, DMA_TO_DEVICE) == 0) {
+		done = s3c2440_nand_dma_wait(info);
+		s3c2410_nand_account(&info->stats.dma_write, done, start);
+		if (done == len)
+			return;
+
+		/* the DMA failed, write the rest of the buffer by PIO */
+		buf += done;
+		len -= done;
+		start = ktime_get();
+	}
 
 	writesl(info->regs + S3C2440_NFDATA, buf, len >> 2);
 
 	/* cleanup any fractional write */
 	if (len & 3) {
-		buf += len & ~3;
+		const u_char *ptr = buf + (len & ~3);
+		int left;
+
+		for (left = len & 3; left; left--, ptr++)
+			writeb(*ptr, info->regs + S3C2440_NFDATA);
+	}
+
+	s3c2410_nand_account(&info->stats.pio_write, len, start);
+}
+
+/* S3C2440 hardware ECC page read
+ *
+ * This replaces the generic nand_read_page_hwecc() loop, which reads
+ * every step, then the OOB, and only then runs the correction routine
+ * on each step in turn.
+*/
+
+static void s3c2440_nand_check_step(struct mtd_info *mtd, u_char *dat,
+				    u_char *read_ecc, u_char *calc_ecc)
+{
+	int stat;
+
+	/* nearly every step is clean, so only call the correction
+	 * routine if the syndrome is non-zero */
+	if (read_ecc[0] == calc_ecc[0] &&
+	    read_ecc[1] == calc_ecc[1] &&
+	    read_ecc[2] == calc_ecc[2])
+		return;
+
+	stat = s3c2410_nand_correct_data(mtd, dat, read_ecc, calc_ecc);
+	if (stat < 0)
+		mtd->ecc_stats.failed++;
+	else
+		mtd->ecc_stats.corrected += stat;
+}
+
+/**
+ * s3c2440_nand_read_page_hwecc - hardware ECC page read
+ * @mtd: The MTD instance for this chip.
+ * @chip: The NAND chip information.
+ * @buf: The buffer to store the page data in.
+ * @page: The page number being read.
+ *
+ * On large page chips the stored ECC is fetched from the OOB first with
+ * a random data output command, so that step N can be checked while
+ * step N+1 is being transferred by DMA. The calculated ECC is latched
+ * with a single register read per step.
+ */
+static int s3c2440_nand_read_page_hwecc(struct mtd_info *mtd,
+					struct nand_chip *chip,
+					uint8_t *buf, int page)
+{
+	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+	int eccsize = chip->ecc.size;
+	int eccbytes = chip->ecc.bytes;
+	int eccsteps = chip->ecc.steps;
+	uint8_t *ecc_calc = chip->buffers->ecccalc;
+	uint8_t *ecc_code = chip->buffers->ecccode;
+	uint32_t *eccpos = chip->ecc.layout->eccpos;
+	int oob_first = mtd->writesize > 512;
+	uint8_t *p = buf;
+	unsigned long ecc;
+	ktime_t start;
+	int dma, done, overlap;
+	int i;
+
+	if (oob_first) {
+		chip->cmdfunc(mtd, NAND_CMD_RNDOUT, mtd->writesize, -1);
+		chip->read_buf(mtd, chip->oob_poi, mtd->oobsize);
+		chip->cmdfunc(mtd, NAND_CMD_RNDOUT, 0, -1);
+
+		for (i = 0; i < chip->ecc.total; i++)
+			ecc_code[i] = chip->oob_poi[eccpos[i]];
+	}
 
-		for (; len & 3; len--, buf++)
-			writeb(*buf, info->regs + S3C2440_NFDATA);
+	for (i = 0; i < eccsteps; i++, p += eccsize) {
+		s3c2440_nand_enable_hwecc(mtd, NAND_ECC_READ);
+
+		start = ktime_get();
+		dma = s3c2440_nand_can_dma(info, p, eccsize, DMA_FROM_DEVICE) &&
+			s3c2440_nand_dma_submit(info, p, eccsize,
+						DMA_FROM_DEVICE) == 0;
+
+		/* check the previous step while this one is in flight, but
+		 * only if the two steps share no cache line: correcting a
+		 * shared line would dirty it under the running DMA */
+		overlap = oob_first && i > 0 && (!dma ||
+			(IS_ALIGNED((unsigned long)buf, L1_CACHE_BYTES) &&
+			 IS_ALIGNED(eccsize, L1_CACHE_BYTES)));
+		if (overlap)
+			s3c2440_nand_check_step(mtd, p - eccsize,
+						&ecc_code[(i - 1) * eccbytes],
+						&ecc_calc[(i - 1) * eccbytes]);
+
+		done = 0;
+		if (dma) {
+			done = s3c2440_nand_dma_wait(info);
+			s3c2410_nand_account(&info->stats.dma_read,
+					     done, start);
+			start = ktime_get();
+		}
+
+		/* no DMA, or it failed: read the rest of the step by PIO,
+		 * the hardware ECC still sees every byte */
+		if (done < eccsize) {
+			s3c2440_nand_read_pio(info, p + done, eccsize - done);
+			s3c2410_nand_account(&info->stats.pio_read,
+					     eccsize - done, start);
+		}
+
+		if (oob_first && i > 0 && !overlap)
+			s3c2440_nand_check_step(mtd, p - eccsize,
+						&ecc_code[(i - 1) * eccbytes],
+						&ecc_calc[(i - 1) * eccbytes]);
+
+		ecc = readl(info->regs + S3C2440_NFMECC0);
+		ecc_calc[i * eccbytes + 0] = ecc;
+		ecc_calc[i * eccbytes + 1] = ecc >> 8;
+		ecc_calc[i * eccbytes + 2] = ecc >> 16;
 	}
+
+	if (!oob_first) {
+		chip->read_buf(mtd, chip->oob_poi, mtd->oobsize);
+
+		for (i = 0; i < chip->ecc.total; i++)
+			ecc_code[i] = chip->oob_poi[eccpos[i]];
+	}
+
+	/* check the steps not already done inside the loop */
+	for (i = oob_first ? eccsteps - 1 : 0; i < eccsteps; i++)
+		s3c2440_nand_check_step(mtd, buf + i * eccsize,
+					&ecc_code[i * eccbytes],
+					&ecc_calc[i * eccbytes]);
+
+	return 0;
 }
 
 /* cpufreq driver support */
@@ -662,6 +1110,84 @@ static inline void s3c2410_nand_cpufreq_deregister(struct s3c2410_nand_info *inf
 }
 #endif
 
+#ifdef CONFIG_DEBUG_FS
+
+static void s3c2410_nand_show_xfer(struct seq_file *seq, const char *name,
+				   struct s3c2410_nand_xfer_stats *stats)
+{
+	u64 rate = 0;
+
+	/* KiB/s while the transfers were running */
+	if (stats->usecs)
+		rate = div64_u64(stats->bytes * 1000000, stats->usecs) >> 10;
+
+	seq_printf(seq, "%s:\t%lu xfers, %llu bytes, %llu us, %llu KiB/s\n",
+		   name, stats->count,
+		   (unsigned long long)stats->bytes,
+		   (unsigned long long)stats->usecs,
+		   (unsigned long long)rate);
+}
+
+static int s3c2410_nand_stats_show(struct seq_file *seq, void *v)
+{
+	struct s3c2410_nand_info *info = seq->private;
+
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+	seq_printf(seq, "dma channel:\t%d\n",
+		   info->dma < 0 ? -1 : info->dma & ~DMACH_LOW_LEVEL);
+	seq_printf(seq, "use_dma:\t%d\n", use_dma);
+#endif
+	s3c2410_nand_show_xfer(seq, "dma read", &info->stats.dma_read);
+	s3c2410_nand_show_xfer(seq, "dma write", &info->stats.dma_write);
+	s3c2410_nand_show_xfer(seq, "pio read", &info->stats.pio_read);
+	s3c2410_nand_show_xfer(seq, "pio write", &info->stats.pio_write);
+	seq_printf(seq, "dma errors:\t%lu\n", info->stats.dma_errors);
+
+	return 0;
+}
+
+static int s3c2410_nand_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, s3c2410_nand_stats_show, inode->i_private);
+}
+
+static const struct file_operations s3c2410_nand_fops_stats = {
+	.owner		= THIS_MODULE,
+	.open		= s3c2410_nand_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void s3c2410_nand_debugfs_attach(struct s3c2410_nand_info *info)
+{
+	struct device *dev = info->device;
+
+	info->debug_root = debugfs_create_dir(dev_name(dev), NULL);
+	if (info->debug_root == NULL) {
+		dev_err(dev, "failed to create debugfs root\n");
+		return;
+	}
+
+	info->debug_stats = debugfs_create_file("stats", 0444,
+						info->debug_root, info,
+						&s3c2410_nand_fops_stats);
+
+	if (info->debug_stats == NULL)
+		dev_err(dev, "failed to create debug stats file\n");
+}
+
+static void s3c2410_nand_debugfs_remove(struct s3c2410_nand_info *info)
+{
+	debugfs_remove(info->debug_stats);
+	debugfs_remove(info->debug_root);
+}
+
+#else
+static inline void s3c2410_nand_debugfs_attach(struct s3c2410_nand_info *info) { }
+static inline void s3c2410_nand_debugfs_remove(struct s3c2410_nand_info *info) { }
+#endif /* CONFIG_DEBUG_FS */
+
 /* device management functions */
 
 static int s3c24xx_nand_remove(struct platform_device *pdev)
@@ -674,6 +1200,7 @@ static int s3c24xx_nand_remove(struct platform_device *pdev)
 		return 0;
 
 	s3c2410_nand_cpufreq_deregister(info);
+	s3c2410_nand_debugfs_remove(info);
 
 	/* Release all our mtds  and their partitions, then go through
 	 * freeing the resources used
@@ -693,6 +1220,8 @@ static int s3c24xx_nand_remove(struct platform_device *pdev)
 
 	/* free the common resources */
 
+	s3c2440_nand_dma_exit(info);
+
 	if (info->clk != NULL && !IS_ERR(info->clk)) {
 		if (!allow_clk_stop(info))
 			clk_disable(info->clk);
@@ -835,6 +1364,7 @@ static void s3c2410_nand_init_chip(struct s3c2410_nand_info *info,
 		case TYPE_S3C2440:
   			chip->ecc.hwctl     = s3c2440_nand_enable_hwecc;
   			chip->ecc.calculate = s3c2440_nand_calculate_ecc;
+			chip->ecc.read_page = s3c2440_nand_read_page_hwecc;
 			break;
 
 		}
@@ -939,6 +1469,10 @@ static int s3c24xx_nand_probe(struct platform_device *pdev)
 	memset(info, 0, sizeof(*info));
 	platform_set_drvdata(pdev, info);
 
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+	info->dma = -1;
+#endif
+
 	spin_lock_init(&info->controller.lock);
 	init_waitqueue_head(&info->controller.wq);
 
@@ -986,6 +1520,10 @@ static int s3c24xx_nand_probe(struct platform_device *pdev)
 	if (err != 0)
 		goto exit_error;
 
+	err = s3c2440_nand_dma_init(info);
+	if (err != 0)
+		goto exit_error;
+
 	sets = (plat != NULL) ? plat->sets : NULL;
 	nr_sets = (plat != NULL) ? plat->nr_sets : 1;
 
@@ -1036,6 +1574,8 @@ static int s3c24xx_nand_probe(struct platform_device *pdev)
 		clk_disable(info->clk);
 	}
 
+	s3c2410_nand_debugfs_attach(info);
+
 	pr_debug("initialised ok\n");
 	return 0;
 
@@ -0,0 +1,268 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING. If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Test and benchmark the software Hamming ECC of nand_ecc.c. The ECC is
+ * checked against a straightforward bit by bit implementation, correction is
+ * checked with single and double bit errors, and the throughput of ECC
+ * calculation and error checking is measured. No MTD device is needed.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/time.h>
+#include <linux/math64.h>
+#include <linux/mtd/nand_ecc.h>
+
+#define PRINT_PREF KERN_INFO "mtd_nandecctest: "
+
+static int count = 1000;
+module_param(count, int, S_IRUGO);
+MODULE_PARM_DESC(count, "Number of random blocks to check per ECC size");
+
+static int bench = 20000;
+module_param(bench, int, S_IRUGO);
+MODULE_PARM_DESC(bench, "Number of ECC calculations per benchmark "
+			"(0 - do not benchmark)");
+
+static unsigned char *data, *corrupt;
+static struct timeval start, finish;
+
+/*
+ * Calculate the ECC the slow way: rp[2k] is the parity of the bytes with bit k
+ * of the address clear, rp[2k + 1] of the bytes with it set, and cp[2k] and
+ * cp[2k + 1] are the same for the bit positions within the bytes. The ECC
+ * bytes hold the inverted parities.
+ */
+static void ref_calculate_ecc(const unsigned char *buf, unsigned int eccsize,
+			      unsigned char *code)
+{
+	unsigned int rp[18] = { 0 }, cp[6] = { 0 };
+	unsigned int i, j, bit, addrbits = eccsize == 512 ? 9 : 8;
+
+	for (i = 0; i < eccsize; i++) {
+		bit = 0;
+		for (j = 0; j < 8; j++) {
+			unsigned int b = (buf[i] >> j) & 1;
+
+			cp[0 + !!(j & 1)] ^= b;
+			cp[2 + !!(j & 2)] ^= b;
+			cp[4 + !!(j & 4)] ^= b;
+			bit ^= b;
+		}
+		for (j = 0; j < addrbits; j++)
+			rp[2 * j + !!(i & (1 << j))] ^= bit;
+	}
+
+	code[0] = code[1] = code[2] = 0;
+	for (j = 0; j < 8; j++) {
+#ifdef CONFIG_MTD_NAND_ECC_SMC
+		code[0] |= !rp[j] << j;
+		code[1] |= !rp[j + 8] << j;
+#else
+		code[1] |= !rp[j] << j;
+		code[0] |= !rp[j + 8] << j;
+#endif
+	}
+	for (j = 0; j < 6; j++)
+		code[2] |= !cp[j] << (j + 2);
+	if (eccsize == 512)
+		code[2] |= (!rp[17] << 1) | !rp[16];
+	else
+		code[2] |= 3;
+}
+
+static void set_random_data(unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; ++i)
+		buf[i] = random32();
+}
+
+static int check_calculate(unsigned int eccsize)
+{
+	int i;
+	unsigned char ecc[3], ref[3];
+
+	for (i = 0; i < count; i++) {
+		if (i == 0)
+			memset(data, 0xFF, eccsize);
+		else if (i == 1)
+			memset(data, 0, eccsize);
+		else
+			set_random_data(data, eccsize);
+
+		__nand_calculate_ecc(data, eccsize, ecc);
+		ref_calculate_ecc(data, eccsize, ref);
+		if (memcmp(ecc, ref, 3)) {
+			printk(PRINT_PREF "error: %u-byte ECC %02x %02x %02x, "
+			       "expected %02x %02x %02x\n", eccsize, ecc[0],
+			       ecc[1], ecc[2], ref[0], ref[1], ref[2]);
+			return -EINVAL;
+		}
+		cond_resched();
+	}
+	return 0;
+}
+
+static int check_correct(unsigned int eccsize)
+{
+	int i, ret, bit, bit2;
+	unsigned char read_ecc[3], calc_ecc[3];
+
+	for (i = 0; i < count; i++) {
+		set_random_data(data, eccsize);
+		__nand_calculate_ecc(data, eccsize, read_ecc);
+
+		/* Single bit error in the data */
+		memcpy(corrupt, data, eccsize);
+		bit = random32() % (eccsize * 8);
+		corrupt[bit / 8] ^= 1 << (bit % 8);
+		__nand_calculate_ecc(corrupt, eccsize, calc_ecc);
+		ret = __nand_correct_data(corrupt, read_ecc, calc_ecc, eccsize);
+		if (ret != 1 || memcmp(corrupt, data, eccsize)) {
+			printk(PRINT_PREF "error: %u-byte block, bit %d not "
+			       "corrected (%d)\n", eccsize, bit, ret);
+			return -EINVAL;
+		}
+
+		/* Single bit error in the ECC */
+		__nand_calculate_ecc(data, eccsize, calc_ecc);
+		bit = random32() % 24;
+		read_ecc[bit / 8] ^= 1 << (bit % 8);
+		ret = __nand_correct_data(corrupt, read_ecc, calc_ecc, eccsize);
+		read_ecc[bit / 8] ^= 1 << (bit % 8);
+		if (ret != 1 || memcmp(corrupt, data, eccsize)) {
+			printk(PRINT_PREF "error: %u-byte block, ECC bit %d "
+			       "not detected (%d)\n", eccsize, bit, ret);
+			return -EINVAL;
+		}
+		cond_resched();
+	}
+
+	/* Double bit error in the data, must not be "corrected" */
+	set_random_data(data, eccsize);
+	__nand_calculate_ecc(data, eccsize, read_ecc);
+	memcpy(corrupt, data, eccsize);
+	bit = random32() % (eccsize * 8);
+	do {
+		bit2 = random32() % (eccsize * 8);
+	} while (bit2 == bit);
+	corrupt[bit / 8] ^= 1 << (bit % 8);
+	corrupt[bit2 / 8] ^= 1 << (bit2 % 8);
+	__nand_calculate_ecc(corrupt, eccsize, calc_ecc);
+	ret = __nand_correct_data(corrupt, read_ecc, calc_ecc, eccsize);
+	if (ret == -1) {
+		/* __nand_correct_data() has just complained */
+		printk(KERN_CONT "(expected)\n");
+	} else {
+		printk(PRINT_PREF "error: %u-byte block, bits %d and %d not "
+		       "detected (%d)\n", eccsize, bit, bit2, ret);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static long calc_speed(unsigned int eccsize)
+{
+	long us;
+
+	us = (finish.tv_sec - start.tv_sec) * 1000000 +
+	     (finish.tv_usec - start.tv_usec);
+	if (us <= 0)
+		return 0;
+	return div_u64((u64)bench * eccsize * 1000000 / 1024, us);
+}
+
+static void benchmark(unsigned int eccsize)
+{
+	int i;
+	unsigned char read_ecc[3], calc_ecc[3];
+
+	set_random_data(data, eccsize);
+
+	do_gettimeofday(&start);
+	for (i = 0; i < bench; i++)
+		__nand_calculate_ecc(data, eccsize, calc_ecc);
+	do_gettimeofday(&finish);
+	printk(PRINT_PREF "%u-byte ECC calculation: %ld KiB/s\n", eccsize,
+	       calc_speed(eccsize));
+
+	/* Reading a page: calculate and check, no errors */
+	__nand_calculate_ecc(data, eccsize, read_ecc);
+	do_gettimeofday(&start);
+	for (i = 0; i < bench; i++) {
+		__nand_calculate_ecc(data, eccsize, calc_ecc);
+		__nand_correct_data(data, read_ecc, calc_ecc, eccsize);
+	}
+	do_gettimeofday(&finish);
+	printk(PRINT_PREF "%u-byte ECC calculation and check: %ld KiB/s\n",
+	       eccsize, calc_speed(eccsize));
+}
+
+static int __init mtd_nandecctest_init(void)
+{
+	int err = -ENOMEM;
+	unsigned int eccsize;
+
+	printk(KERN_INFO "\n");
+	printk(KERN_INFO "=================================================\n");
+
+	data = kmalloc(512, GFP_KERNEL);
+	corrupt = kmalloc(512, GFP_KERNEL);
+	if (!data || !corrupt) {
+		printk(PRINT_PREF "error: cannot allocate memory\n");
+		goto out;
+	}
+
+	for (eccsize = 256; eccsize <= 512; eccsize += 256) {
+		printk(PRINT_PREF "checking %u-byte ECC calculation\n", eccsize);
+		err = check_calculate(eccsize);
+		if (err)
+			goto out;
+
+		printk(PRINT_PREF "checking %u-byte ECC correction\n", eccsize);
+		err = check_correct(eccsize);
+		if (err)
+			goto out;
+
+		if (bench > 0)
+			benchmark(eccsize);
+	}
+
+	printk(PRINT_PREF "finished\n");
+out:
+	kfree(corrupt);
+	kfree(data);
+	if (err)
+		printk(PRINT_PREF "error %d occurred\n", err);
+	printk(KERN_INFO "=================================================\n");
+	return err;
+}
+module_init(mtd_nandecctest_init);
+
+static void __exit mtd_nandecctest_exit(void)
+{
+	return;
+}
+module_exit(mtd_nandecctest_exit);
+
+MODULE_DESCRIPTION("NAND ECC test module");
+MODULE_LICENSE("GPL");
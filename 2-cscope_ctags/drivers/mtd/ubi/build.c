@@ -122,6 +122,12 @@ static struct device_attribute dev_bgt_enabled =
 	__ATTR(bgt_enabled, S_IRUGO, dev_attribute_show, NULL);
 static struct device_attribute dev_mtd_num =
 	__ATTR(mtd_num, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_free_eraseblocks =
+	__ATTR(free_eraseblocks, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_peb_waits =
+	__ATTR(peb_waits, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_peb_wait_works =
+	__ATTR(peb_wait_works, S_IRUGO, dev_attribute_show, NULL);
 
 /**
  * ubi_volume_notify - send a volume change notification.
@@ -346,6 +352,12 @@ static ssize_t dev_attribute_show(struct device *dev,
 		ret = sprintf(buf, "%d\n", ubi->thread_enabled);
 	else if (attr == &dev_mtd_num)
 		ret = sprintf(buf, "%d\n", ubi->mtd->index);
+	else if (attr == &dev_free_eraseblocks)
+		ret = sprintf(buf, "%d\n", ubi->free_count);
+	else if (attr == &dev_peb_waits)
+		ret = sprintf(buf, "%u\n", ubi->peb_waits);
+	else if (attr == &dev_peb_wait_works)
+		ret = sprintf(buf, "%u\n", ubi->peb_wait_works);
 	else
 		ret = -EINVAL;
 
@@ -410,6 +422,15 @@ static int ubi_sysfs_init(struct ubi_device *ubi)
 	if (err)
 		return err;
 	err = device_create_file(&ubi->dev, &dev_mtd_num);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_free_eraseblocks);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_peb_waits);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_peb_wait_works);
 	return err;
 }
 
@@ -419,6 +440,9 @@ static int ubi_sysfs_init(struct ubi_device *ubi)
  */
 static void ubi_sysfs_close(struct ubi_device *ubi)
 {
+	device_remove_file(&ubi->dev, &dev_peb_wait_works);
+	device_remove_file(&ubi->dev, &dev_peb_waits);
+	device_remove_file(&ubi->dev, &dev_free_eraseblocks);
 	device_remove_file(&ubi->dev, &dev_mtd_num);
 	device_remove_file(&ubi->dev, &dev_bgt_enabled);
 	device_remove_file(&ubi->dev, &dev_min_io_size);
@@ -568,17 +592,25 @@ static void free_internal_volumes(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * Note, if fast attach snapshots are enabled and the flash contains a valid
+ * one, the scanning information is taken from the snapshot instead of
+ * scanning the whole media. Full scanning is still the fall-back attaching
+ * method if the snapshot is missing, stale or corrupted, and also if the
+ * snapshot looks fine but the sub-systems cannot be initialized from it. In
+ * the latter case the snapshot is marked stale before the media is scanned.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
-	int err;
+	int err, snap = 1;
 	struct ubi_scan_info *si;
 
-	si = ubi_scan(ubi);
+	si = ubi_snap_scan(ubi);
+	if (!si) {
+		snap = 0;
+		si = ubi_scan(ubi);
+	}
+
+retry:
 	if (IS_ERR(si))
 		return PTR_ERR(si);
 
@@ -587,6 +619,9 @@ static int attach_by_scanning(struct ubi_device *ubi)
 	ubi->max_ec = si->max_ec;
 	ubi->mean_ec = si->mean_ec;
 
+	/* Nothing may be written before the old snapshot is known */
+	ubi_snap_init(ubi, si);
+
 	err = ubi_read_volume_table(ubi, si);
 	if (err)
 		goto out_si;
@@ -599,6 +634,7 @@ static int attach_by_scanning(struct ubi_device *ubi)
 	if (err)
 		goto out_wl;
 
+	ubi_snap_reserve(ubi);
 	ubi_scan_destroy_si(si);
 	return 0;
 
@@ -606,10 +642,29 @@ out_wl:
 	ubi_wl_close(ubi);
 out_vtbl:
 	free_internal_volumes(ubi);
+	free_user_volumes(ubi);
 	vfree(ubi->vtbl);
 out_si:
 	ubi_scan_destroy_si(si);
-	return err;
+	if (!snap)
+		return err;
+
+	ubi_warn("cannot attach from the snapshot, error %d, scanning", err);
+	if (ubi_snap_invalidate(ubi))
+		ubi_warn("cannot mark the snapshot stale");
+
+	/* Start over as if the snapshot had never been found */
+	memset(ubi->volumes, 0, sizeof(ubi->volumes));
+	ubi->vtbl = NULL;
+	ubi->vol_count = 0;
+	ubi->rsvd_pebs = 0;
+	ubi->beb_rsvd_pebs = 0;
+	ubi->autoresize_vol_id = -1;
+	ubi->image_seq = 0;
+
+	snap = 0;
+	si = ubi_scan(ubi);
+	goto retry;
 }
 
 /**
@@ -829,6 +884,28 @@ static int autoresize(struct ubi_device *ubi, int vol_id)
 	return 0;
 }
 
+/**
+ * stop_bgt - stop the background thread.
+ * @ubi: UBI device description object
+ *
+ * The thread is disabled and forgotten under @ubi->wl_lock before it is
+ * stopped, so work scheduled afterwards (e.g., by writing the snapshot) does
+ * not try to wake up a task which has already exited.
+ */
+static void stop_bgt(struct ubi_device *ubi)
+{
+	struct task_struct *bgt;
+
+	spin_lock(&ubi->wl_lock);
+	bgt = ubi->bgt_thread;
+	ubi->thread_enabled = 0;
+	ubi->bgt_thread = NULL;
+	spin_unlock(&ubi->wl_lock);
+
+	if (bgt)
+		kthread_stop(bgt);
+}
+
 /**
  * ubi_reboot_notifier - halt UBI transactions immediately prior to a reboot.
  * @n: reboot notifier object
@@ -851,8 +928,8 @@ static int ubi_reboot_notifier(struct notifier_block *n, unsigned long state,
 	struct ubi_device *ubi;
 
 	ubi = container_of(n, struct ubi_device, reboot_notifier);
-	if (ubi->bgt_thread)
-		kthread_stop(ubi->bgt_thread);
+	stop_bgt(ubi);
+	ubi_snap_write(ubi);
 	ubi_sync(ubi->ubi_num);
 	return NOTIFY_DONE;
 }
@@ -940,6 +1017,9 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	mutex_init(&ubi->ckvol_mutex);
 	mutex_init(&ubi->device_mutex);
 	spin_lock_init(&ubi->volumes_lock);
+	init_rwsem(&ubi->snap_sem);
+	mutex_init(&ubi->snap_mutex);
+	ubi->snap_pnum = ubi->snap_valid_pnum = -1;
 
 	ubi_msg("attaching mtd%d to ubi%d", mtd->index, ubi_num);
 
@@ -1058,6 +1138,7 @@ out_free:
  */
 int ubi_detach_mtd_dev(int ubi_num, int anyway)
 {
+	int err;
 	struct ubi_device *ubi;
 
 	if (ubi_num < 0 || ubi_num >= UBI_MAX_DEVICES)
@@ -1091,8 +1172,7 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 * prevent it from doing anything on this device while we are freeing.
 	 */
 	unregister_reboot_notifier(&ubi->reboot_notifier);
-	if (ubi->bgt_thread)
-		kthread_stop(ubi->bgt_thread);
+	stop_bgt(ubi);
 
 	/*
 	 * Get a reference to the device in order to prevent 'dev_release()'
@@ -1100,6 +1180,10 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 */
 	get_device(&ubi->dev);
 
+	err = ubi_snap_write(ubi);
+	if (err)
+		ubi_warn("cannot write snapshot, error %d", err);
+
 	uif_close(ubi);
 	ubi_wl_close(ubi);
 	free_internal_volumes(ubi);
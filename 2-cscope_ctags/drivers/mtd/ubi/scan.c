@@ -828,6 +828,27 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 	}
 
 	vol_id = be32_to_cpu(vidh->vol_id);
+	if (vol_id == UBI_SNAP_VOLUME_ID) {
+		unsigned long long sqnum = be64_to_cpu(vidh->sqnum);
+
+		/*
+		 * A fast attach snapshot. It is only good for one attach, so
+		 * it is erased, but we remember the newest one because it has
+		 * to be marked stale before anything is written.
+		 */
+		dbg_bld("snapshot in PEB %d, sqnum %llu", pnum, sqnum);
+		if (si->snap_pnum == -1 || sqnum > si->snap_sqnum) {
+			si->snap_pnum = pnum;
+			si->snap_sqnum = sqnum;
+		}
+		if (si->max_sqnum < sqnum)
+			si->max_sqnum = sqnum;
+		err = add_to_list(si, pnum, ec, &si->erase);
+		if (err)
+			return err;
+		goto adjust_mean_ec;
+	}
+
 	if (vol_id > UBI_MAX_VOLUMES && vol_id != UBI_LAYOUT_VOLUME_ID) {
 		int lnum = be32_to_cpu(vidh->lnum);
 
@@ -909,6 +930,7 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	INIT_LIST_HEAD(&si->alien);
 	si->volumes = RB_ROOT;
 	si->is_empty = 1;
+	si->snap_pnum = -1;
 
 	err = -ENOMEM;
 	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
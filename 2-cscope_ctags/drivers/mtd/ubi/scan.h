@@ -103,6 +103,8 @@ struct ubi_scan_volume {
  * @ec_sum: a temporary variable used when calculating @mean_ec
  * @ec_count: a temporary variable used when calculating @mean_ec
  * @corr_count: count of corrupted PEBs
+ * @snap_pnum: PEB containing the newest fast attach snapshot (%-1 if none)
+ * @snap_sqnum: sequence number of the @snap_pnum snapshot
  *
  * This data structure contains the result of scanning and may be used by other
  * UBI sub-systems to build final UBI data structures, further error-recovery
@@ -126,6 +128,8 @@ struct ubi_scan_info {
 	uint64_t ec_sum;
 	int ec_count;
 	int corr_count;
+	int snap_pnum;
+	unsigned long long snap_sqnum;
 };
 
 struct ubi_device;
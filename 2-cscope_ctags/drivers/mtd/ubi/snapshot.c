@@ -0,0 +1,788 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * UBI fast attach snapshots.
+ *
+ * Attaching an UBI device requires reading the EC and VID headers of every
+ * physical eraseblock, which takes a lot of time on large flashes. This
+ * sub-system stores everything scanning would find out - erase counters,
+ * volumes and the LEB to PEB mapping - in one physical eraseblock, which is
+ * called a snapshot, and attaching then reads just this one PEB.
+ *
+ * The snapshot is written when the device is detached, on reboot, and when
+ * nothing has been written to the device for @snapshot_idle seconds. It is
+ * stored in one of the first %UBI_SNAP_MAX_ANCHOR PEBs of the device, so
+ * attaching only has to look at these to find it. The snapshot PEB belongs to
+ * the snapshot volume (%UBI_SNAP_VOLUME_ID), which is not a real volume, and
+ * it is taken out of the WL sub-system while it is in use.
+ *
+ * A snapshot describes the flash only until the next modification. Instead of
+ * erasing the snapshot PEB before the first write or erasure following a
+ * snapshot, which would make every first write slow, the last minimal I/O
+ * unit of the PEB is programmed. The snapshot data never covers this unit, so
+ * an erased last unit means the snapshot is still good. Flash modifications
+ * which are not covered by the snapshot are excluded while it is taken by
+ * means of @ubi->snap_sem, which is taken in read mode by the EBA sub-system
+ * whenever it changes a LEB.
+ *
+ * A snapshot is good for one attach only: the snapshot PEB itself is
+ * described as a PEB to be erased, so it goes back to the free pool and a new
+ * snapshot is written next time. If anything is wrong with the snapshot, UBI
+ * falls back to full scanning.
+ */
+
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include <linux/jiffies.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include "ubi.h"
+
+/* Write a snapshot after this many seconds without flash modifications */
+static unsigned int snapshot_idle = 30;
+module_param(snapshot_idle, uint, 0644);
+MODULE_PARM_DESC(snapshot_idle, "Seconds of idleness after which a fast "
+			       "attach snapshot is written (0 - only on "
+			       "detach and reboot)");
+
+/**
+ * snap_max_size - maximum size of a snapshot.
+ * @ubi: UBI device description object
+ */
+static int snap_max_size(const struct ubi_device *ubi)
+{
+	return UBI_SNAP_HDR_SIZE +
+	       (ubi->vtbl_slots + UBI_INT_VOL_COUNT) * UBI_SNAP_VOL_SIZE +
+	       ubi->peb_count * UBI_SNAP_PEB_SIZE;
+}
+
+/**
+ * snap_is_stale - check whether a snapshot is stale.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock containing the snapshot
+ *
+ * This function returns %1 if the snapshot in @pnum has been marked stale,
+ * %0 if it has not, and a negative error code in case of failure.
+ */
+static int snap_is_stale(struct ubi_device *ubi, int pnum)
+{
+	int i, err;
+	uint8_t *buf;
+
+	buf = kmalloc(ubi->min_io_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	err = ubi_io_read(ubi, buf, pnum, ubi->peb_size - ubi->min_io_size,
+			  ubi->min_io_size);
+	if (err == -EBADMSG)
+		/* Partially programmed marker - the snapshot is stale */
+		err = 1;
+	else if (err >= 0) {
+		err = 0;
+		for (i = 0; i < ubi->min_io_size; i++)
+			if (buf[i] != 0xFF) {
+				err = 1;
+				break;
+			}
+	}
+
+	kfree(buf);
+	return err;
+}
+
+/**
+ * snap_mark_stale - mark a snapshot stale.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock containing the snapshot
+ *
+ * This function programs the last minimal I/O unit of @pnum. The write goes
+ * to the MTD device directly because it must not count as a flash
+ * modification itself. Returns zero in case of success and a negative error
+ * code in case of failure.
+ */
+static int snap_mark_stale(struct ubi_device *ubi, int pnum)
+{
+	int err;
+	size_t written;
+	loff_t addr;
+	void *buf;
+
+	dbg_gen("mark snapshot in PEB %d stale", pnum);
+	buf = kzalloc(ubi->min_io_size, GFP_NOFS);
+	if (!buf)
+		return -ENOMEM;
+
+	addr = (loff_t)pnum * ubi->peb_size + ubi->peb_size - ubi->min_io_size;
+	err = ubi->mtd->write(ubi->mtd, addr, ubi->min_io_size, &written, buf);
+	if (!err && written != ubi->min_io_size)
+		err = -EIO;
+	if (err) {
+		ubi_err("cannot mark snapshot in PEB %d stale, error %d",
+			pnum, err);
+		/*
+		 * The next attach would trust the snapshot, so nothing may be
+		 * written any more.
+		 */
+		ubi_ro_mode(ubi);
+	}
+
+	kfree(buf);
+	return err;
+}
+
+/**
+ * ubi_snap_invalidate - note a flash modification.
+ * @ubi: UBI device description object
+ *
+ * This function has to be called before anything is written to or erased on
+ * the flash. If there is a snapshot which still describes the flash, it is
+ * marked stale. Returns zero in case of success and a negative error code in
+ * case of failure.
+ */
+int ubi_snap_invalidate(struct ubi_device *ubi)
+{
+	int err = 0;
+
+	if (ubi->snap_writer == current)
+		return 0;
+
+	atomic_inc(&ubi->snap_mod_seq);
+	smp_mb__after_atomic_inc();
+	ubi->snap_mod_time = jiffies;
+
+	if (ubi->snap_valid_pnum == -1)
+		return 0;
+
+	mutex_lock(&ubi->snap_mutex);
+	if (ubi->snap_valid_pnum != -1) {
+		err = snap_mark_stale(ubi, ubi->snap_valid_pnum);
+		if (!err)
+			ubi->snap_valid_pnum = -1;
+	}
+	mutex_unlock(&ubi->snap_mutex);
+
+	/* Let the background thread start counting idle time */
+	spin_lock(&ubi->wl_lock);
+	if (ubi->thread_enabled && ubi->bgt_thread)
+		wake_up_process(ubi->bgt_thread);
+	spin_unlock(&ubi->wl_lock);
+
+	return err;
+}
+
+/**
+ * snap_add_to_list - add a physical eraseblock to a scanning list.
+ * @si: scanning information
+ * @pnum: physical eraseblock number
+ * @ec: erase counter of the physical eraseblock
+ * @list: the list to add to
+ *
+ * Returns zero in case of success and %-ENOMEM in case of failure.
+ */
+static int snap_add_to_list(struct ubi_scan_info *si, int pnum, int ec,
+			    struct list_head *list)
+{
+	struct ubi_scan_leb *seb;
+
+	seb = kmalloc(sizeof(struct ubi_scan_leb), GFP_KERNEL);
+	if (!seb)
+		return -ENOMEM;
+
+	seb->pnum = pnum;
+	seb->ec = ec;
+	list_add_tail(&seb->u.list, list);
+	return 0;
+}
+
+/**
+ * snap_find_anchor - find the newest snapshot.
+ * @ubi: UBI device description object
+ * @vid_hdr: buffer for VID headers
+ * @sqnum: the sequence number of the snapshot is returned here
+ *
+ * This function returns the physical eraseblock containing the newest
+ * snapshot, %-ENOENT if there is none, and other negative error codes in case
+ * of failure.
+ */
+static int snap_find_anchor(struct ubi_device *ubi,
+			    struct ubi_vid_hdr *vid_hdr,
+			    unsigned long long *sqnum)
+{
+	int err, pnum, anchor = -ENOENT;
+
+	for (pnum = 0; pnum < ubi->peb_count && pnum < UBI_SNAP_MAX_ANCHOR;
+	     pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			return err;
+		if (err)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err < 0)
+			return err;
+		if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		if (be32_to_cpu(vid_hdr->vol_id) != UBI_SNAP_VOLUME_ID)
+			continue;
+
+		if (anchor < 0 || be64_to_cpu(vid_hdr->sqnum) > *sqnum) {
+			anchor = pnum;
+			*sqnum = be64_to_cpu(vid_hdr->sqnum);
+		}
+	}
+
+	return anchor;
+}
+
+/**
+ * snap_build_si - build scanning information from a snapshot.
+ * @ubi: UBI device description object
+ * @si: scanning information to fill
+ * @buf: the snapshot
+ *
+ * Returns zero in case of success, %1 if the snapshot is inconsistent, and a
+ * negative error code in case of failure.
+ */
+static int snap_build_si(struct ubi_device *ubi, struct ubi_scan_info *si,
+			 const void *buf)
+{
+	int err, pnum, vol_count, ec;
+	const struct ubi_snap_hdr *hdr = buf;
+	const struct ubi_snap_vol *vols;
+	const struct ubi_snap_peb *pebs;
+	struct ubi_vid_hdr vid_hdr;
+
+	vol_count = be32_to_cpu(hdr->vol_count);
+	vols = buf + UBI_SNAP_HDR_SIZE;
+	pebs = buf + UBI_SNAP_HDR_SIZE + vol_count * UBI_SNAP_VOL_SIZE;
+
+	si->min_ec = UBI_MAX_ERASECOUNTER;
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		const struct ubi_snap_peb *peb = &pebs[pnum];
+		const struct ubi_snap_vol *vol;
+		int vol_idx;
+
+		ec = be32_to_cpu(peb->ec);
+		if (peb->type != UBI_SNAP_PEB_BAD &&
+		    peb->type != UBI_SNAP_PEB_ALIEN &&
+		    (ec < 0 || ec > UBI_MAX_ERASECOUNTER))
+			return 1;
+
+		switch (peb->type) {
+		case UBI_SNAP_PEB_FREE:
+			err = snap_add_to_list(si, pnum, ec, &si->free);
+			break;
+		case UBI_SNAP_PEB_ERASE:
+			err = snap_add_to_list(si, pnum, ec, &si->erase);
+			break;
+		case UBI_SNAP_PEB_BAD:
+			si->bad_peb_count += 1;
+			continue;
+		case UBI_SNAP_PEB_ALIEN:
+			si->alien_peb_count += 1;
+			err = snap_add_to_list(si, pnum, UBI_SCAN_UNKNOWN_EC,
+					       &si->alien);
+			if (err)
+				return err;
+			continue;
+		case UBI_SNAP_PEB_USED:
+			vol_idx = be16_to_cpu(peb->vol_idx);
+			if (vol_idx >= vol_count)
+				return 1;
+			vol = &vols[vol_idx];
+
+			memset(&vid_hdr, 0, sizeof(struct ubi_vid_hdr));
+			vid_hdr.vol_type = vol->vol_type;
+			vid_hdr.compat = vol->compat;
+			vid_hdr.vol_id = vol->vol_id;
+			vid_hdr.lnum = peb->lnum;
+			vid_hdr.data_pad = vol->data_pad;
+			if (vol->vol_type == UBI_VID_STATIC) {
+				vid_hdr.used_ebs = vol->used_ebs;
+				vid_hdr.data_size = vol->last_data_size;
+			}
+			err = ubi_scan_add_used(ubi, si, pnum, ec, &vid_hdr,
+						peb->scrub);
+			break;
+		default:
+			return 1;
+		}
+		if (err)
+			return err;
+
+		si->ec_sum += ec;
+		si->ec_count += 1;
+		if (ec > si->max_ec)
+			si->max_ec = ec;
+		if (ec < si->min_ec)
+			si->min_ec = ec;
+	}
+
+	if (si->ec_count)
+		si->mean_ec = div_u64(si->ec_sum, si->ec_count);
+	return 0;
+}
+
+/**
+ * ubi_snap_scan - get scanning information from a snapshot.
+ * @ubi: UBI device description object
+ *
+ * This function looks for a snapshot and builds the scanning information from
+ * it. Returns the scanning information in case of success, %NULL if there is
+ * no usable snapshot and the device has to be scanned, and an error pointer
+ * if memory allocation failed.
+ */
+struct ubi_scan_info *ubi_snap_scan(struct ubi_device *ubi)
+{
+	int err, anchor, size;
+	unsigned long start = jiffies;
+	unsigned long long sqnum = 0;
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_ec_hdr *ec_hdr;
+	struct ubi_snap_hdr *hdr;
+	struct ubi_scan_info *si = NULL;
+	void *buf = NULL;
+	uint32_t crc;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		return ERR_PTR(-ENOMEM);
+
+	err = anchor = snap_find_anchor(ubi, vid_hdr, &sqnum);
+	if (err == -ENOENT)
+		err = 0;
+	if (anchor < 0)
+		goto out_vid_hdr;
+
+	dbg_bld("snapshot in PEB %d, sqnum %llu", anchor, sqnum);
+	err = snap_is_stale(ubi, anchor);
+	if (err) {
+		if (err > 0)
+			dbg_bld("snapshot is stale");
+		goto out_vid_hdr;
+	}
+
+	err = -ENOMEM;
+	ec_hdr = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	if (!ec_hdr)
+		goto out_vid_hdr;
+
+	err = ubi_io_read_ec_hdr(ubi, anchor, ec_hdr, 0);
+	if (err && err != UBI_IO_BITFLIPS) {
+		kfree(ec_hdr);
+		goto out_vid_hdr;
+	}
+	ubi->image_seq = be32_to_cpu(ec_hdr->image_seq);
+	kfree(ec_hdr);
+
+	err = -ENOMEM;
+	buf = vmalloc(ubi->leb_size);
+	if (!buf)
+		goto out_vid_hdr;
+
+	err = ubi_io_read_data(ubi, buf, anchor, 0, UBI_SNAP_HDR_SIZE);
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out_buf;
+
+	err = 1;
+	hdr = buf;
+	if (be32_to_cpu(hdr->magic) != UBI_SNAP_HDR_MAGIC)
+		goto out_buf;
+
+	crc = crc32(UBI_CRC32_INIT, hdr, UBI_SNAP_HDR_SIZE_CRC);
+	if (crc != be32_to_cpu(hdr->hdr_crc)) {
+		ubi_warn("bad snapshot header CRC in PEB %d", anchor);
+		goto out_buf;
+	}
+
+	size = be32_to_cpu(hdr->data_size);
+	if (hdr->version != UBI_SNAP_VERSION ||
+	    be32_to_cpu(hdr->peb_count) != ubi->peb_count ||
+	    be32_to_cpu(hdr->vol_count) > ubi->vtbl_slots + UBI_INT_VOL_COUNT ||
+	    size != be32_to_cpu(hdr->vol_count) * UBI_SNAP_VOL_SIZE +
+		    ubi->peb_count * UBI_SNAP_PEB_SIZE ||
+	    UBI_SNAP_HDR_SIZE + size > ubi->leb_size - ubi->min_io_size) {
+		ubi_warn("unusable snapshot in PEB %d", anchor);
+		goto out_buf;
+	}
+
+	err = ubi_io_read_data(ubi, buf + UBI_SNAP_HDR_SIZE, anchor,
+			       UBI_SNAP_HDR_SIZE, size);
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out_buf;
+
+	err = 1;
+	crc = crc32(UBI_CRC32_INIT, buf + UBI_SNAP_HDR_SIZE, size);
+	if (crc != be32_to_cpu(hdr->data_crc)) {
+		ubi_warn("bad snapshot data CRC in PEB %d", anchor);
+		goto out_buf;
+	}
+
+	err = -ENOMEM;
+	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	if (!si)
+		goto out_buf;
+
+	INIT_LIST_HEAD(&si->corr);
+	INIT_LIST_HEAD(&si->free);
+	INIT_LIST_HEAD(&si->erase);
+	INIT_LIST_HEAD(&si->alien);
+	si->volumes = RB_ROOT;
+	si->snap_pnum = anchor;
+	si->snap_sqnum = sqnum;
+	si->max_sqnum = be64_to_cpu(hdr->sqnum);
+	if (si->max_sqnum < sqnum)
+		si->max_sqnum = sqnum;
+
+	err = snap_build_si(ubi, si, buf);
+	if (err) {
+		ubi_scan_destroy_si(si);
+		si = NULL;
+		if (err > 0)
+			ubi_warn("inconsistent snapshot in PEB %d", anchor);
+		goto out_buf;
+	}
+
+	vfree(buf);
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	ubi_msg("attached from snapshot in PEB %d in %u ms", anchor,
+		jiffies_to_msecs(jiffies - start));
+	return si;
+
+out_buf:
+	vfree(buf);
+out_vid_hdr:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	if (err == -ENOMEM)
+		return ERR_PTR(err);
+	if (err < 0)
+		ubi_warn("cannot read snapshot, error %d, scanning", err);
+	ubi->image_seq = 0;
+	return NULL;
+}
+
+/**
+ * ubi_snap_init - initialize the snapshot sub-system.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * This function remembers the newest snapshot found on the flash. It has to
+ * be marked stale before the flash is modified, otherwise the next attach
+ * would trust it. This function has to be called before anything is written.
+ */
+void ubi_snap_init(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	if (si->snap_pnum == -1)
+		return;
+
+	/* If the marker cannot be read, be on the safe side and mark it */
+	if (snap_is_stale(ubi, si->snap_pnum) <= 0)
+		ubi->snap_valid_pnum = si->snap_pnum;
+}
+
+/**
+ * ubi_snap_reserve - reserve a physical eraseblock for snapshots.
+ * @ubi: UBI device description object
+ *
+ * This function enables snapshots for the device if they fit into one
+ * logical eraseblock and there is an available physical eraseblock to reserve
+ * for them. It is called when the EBA sub-system has reserved its PEBs.
+ */
+void ubi_snap_reserve(struct ubi_device *ubi)
+{
+	ubi->snap_mod_time = jiffies;
+	if (ubi->ro_mode)
+		return;
+
+	if (snap_max_size(ubi) > ubi->leb_size - ubi->min_io_size) {
+		ubi_warn("too many PEBs for a snapshot, snapshots disabled");
+		return;
+	}
+
+	spin_lock(&ubi->volumes_lock);
+	if (ubi->avail_pebs < 1) {
+		spin_unlock(&ubi->volumes_lock);
+		ubi_warn("no PEB available for snapshots, snapshots disabled");
+		return;
+	}
+	ubi->avail_pebs -= 1;
+	ubi->rsvd_pebs += 1;
+	ubi->snap_enabled = 1;
+	spin_unlock(&ubi->volumes_lock);
+}
+
+/**
+ * snap_fill - build a snapshot.
+ * @ubi: UBI device description object
+ * @buf: buffer of the logical eraseblock size to build the snapshot in
+ *
+ * The caller has to hold @ubi->device_mutex and @ubi->snap_sem in write mode.
+ * Returns the snapshot size aligned to the minimal I/O unit size.
+ */
+static int snap_fill(struct ubi_device *ubi, void *buf)
+{
+	int i, pnum, lnum, vol_count = 0, size;
+	struct ubi_snap_hdr *hdr = buf;
+	struct ubi_snap_vol *vols = buf + UBI_SNAP_HDR_SIZE;
+	struct ubi_snap_peb *pebs;
+	struct ubi_wl_entry *e;
+	struct rb_node *rb;
+
+	memset(buf, 0, ubi->leb_size);
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++)
+		if (ubi->volumes[i])
+			vol_count += 1;
+	pebs = buf + UBI_SNAP_HDR_SIZE + vol_count * UBI_SNAP_VOL_SIZE;
+
+	/*
+	 * Everything the WL sub-system knows about, but which is neither free
+	 * nor mapped, is going to be erased.
+	 */
+	spin_lock(&ubi->wl_lock);
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		e = ubi->lookuptbl[pnum];
+		if (!e)
+			continue;
+		pebs[pnum].type = UBI_SNAP_PEB_ERASE;
+		pebs[pnum].ec = cpu_to_be32(e->ec);
+	}
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb)
+		pebs[e->pnum].type = UBI_SNAP_PEB_FREE;
+	ubi_rb_for_each_entry(rb, e, &ubi->scrub, u.rb)
+		pebs[e->pnum].scrub = 1;
+	spin_unlock(&ubi->wl_lock);
+
+	vol_count = 0;
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+		struct ubi_snap_vol *rec = &vols[vol_count];
+
+		if (!vol)
+			continue;
+
+		rec->vol_id = cpu_to_be32(vol->vol_id);
+		rec->data_pad = cpu_to_be32(vol->data_pad);
+		if (vol->vol_type == UBI_STATIC_VOLUME) {
+			rec->vol_type = UBI_VID_STATIC;
+			rec->used_ebs = cpu_to_be32(vol->used_ebs);
+			rec->last_data_size = cpu_to_be32(vol->last_eb_bytes);
+		} else
+			rec->vol_type = UBI_VID_DYNAMIC;
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			rec->compat = UBI_LAYOUT_VOLUME_COMPAT;
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			pnum = vol->eba_tbl[lnum];
+			if (pnum == UBI_LEB_UNMAPPED)
+				continue;
+			pebs[pnum].type = UBI_SNAP_PEB_USED;
+			pebs[pnum].lnum = cpu_to_be32(lnum);
+			pebs[pnum].vol_idx = cpu_to_be16(vol_count);
+		}
+		vol_count += 1;
+	}
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		if (pebs[pnum].type)
+			continue;
+		if (ubi_io_is_bad(ubi, pnum) > 0)
+			pebs[pnum].type = UBI_SNAP_PEB_BAD;
+		else
+			pebs[pnum].type = UBI_SNAP_PEB_ALIEN;
+	}
+
+	size = vol_count * UBI_SNAP_VOL_SIZE + ubi->peb_count * UBI_SNAP_PEB_SIZE;
+	hdr->magic = cpu_to_be32(UBI_SNAP_HDR_MAGIC);
+	hdr->version = UBI_SNAP_VERSION;
+	hdr->peb_count = cpu_to_be32(ubi->peb_count);
+	hdr->vol_count = cpu_to_be32(vol_count);
+	hdr->data_size = cpu_to_be32(size);
+	hdr->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT,
+					  buf + UBI_SNAP_HDR_SIZE, size));
+
+	return ALIGN(UBI_SNAP_HDR_SIZE + size, ubi->min_io_size);
+}
+
+/**
+ * snap_write - write a snapshot.
+ * @ubi: UBI device description object
+ *
+ * The caller has to hold @ubi->device_mutex. Returns zero in case of success
+ * or if no snapshot is needed, and a negative error code in case of failure.
+ */
+static int snap_write(struct ubi_device *ubi)
+{
+	int err, pnum, len, seq;
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_snap_hdr *hdr;
+	void *buf;
+
+	if (!ubi->snap_enabled || ubi->ro_mode || ubi->snap_valid_pnum != -1)
+		return 0;
+
+	if (ubi->snap_pnum != -1) {
+		err = ubi_wl_put_snap_peb(ubi, ubi->snap_pnum);
+		if (err)
+			return err;
+		ubi->snap_pnum = -1;
+	}
+
+	err = ubi_wl_flush(ubi);
+	if (err)
+		return err;
+
+	buf = vmalloc(ubi->leb_size);
+	if (!buf)
+		return -ENOMEM;
+
+	err = -ENOMEM;
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		goto out_buf;
+
+	pnum = ubi_wl_get_snap_peb(ubi, UBI_SNAP_MAX_ANCHOR);
+	if (pnum < 0) {
+		err = pnum;
+		if (err == -ENOSPC) {
+			dbg_gen("no free PEB for the snapshot");
+			err = 0;
+		}
+		goto out_vid_hdr;
+	}
+	ubi->snap_pnum = pnum;
+
+	down_write(&ubi->snap_sem);
+	seq = atomic_read(&ubi->snap_mod_seq);
+	len = snap_fill(ubi, buf);
+
+	vid_hdr->vol_type = UBI_SNAP_VOLUME_TYPE;
+	vid_hdr->compat = UBI_SNAP_VOLUME_COMPAT;
+	vid_hdr->vol_id = cpu_to_be32(UBI_SNAP_VOLUME_ID);
+	vid_hdr->lnum = 0;
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+
+	hdr = buf;
+	hdr->sqnum = vid_hdr->sqnum;
+	hdr->hdr_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, hdr,
+					 UBI_SNAP_HDR_SIZE_CRC));
+
+	ubi->snap_writer = current;
+	err = ubi_io_write_vid_hdr(ubi, pnum, vid_hdr);
+	if (!err)
+		err = ubi_io_write_data(ubi, buf, pnum, 0, len);
+	ubi->snap_writer = NULL;
+	if (err) {
+		ubi_err("cannot write snapshot to PEB %d, error %d", pnum, err);
+		goto out_unlock;
+	}
+
+	mutex_lock(&ubi->snap_mutex);
+	ubi->snap_valid_pnum = pnum;
+	mutex_unlock(&ubi->snap_mutex);
+
+	/*
+	 * Something not excluded by @ubi->snap_sem, like an erasure, may have
+	 * modified the flash while the snapshot was taken. Pairs with the
+	 * barrier in 'ubi_snap_invalidate()'.
+	 */
+	smp_mb();
+	if (atomic_read(&ubi->snap_mod_seq) != seq) {
+		mutex_lock(&ubi->snap_mutex);
+		if (ubi->snap_valid_pnum == pnum) {
+			err = snap_mark_stale(ubi, pnum);
+			if (!err)
+				ubi->snap_valid_pnum = -1;
+		}
+		mutex_unlock(&ubi->snap_mutex);
+	} else
+		dbg_gen("snapshot written to PEB %d, %d bytes", pnum, len);
+
+out_unlock:
+	up_write(&ubi->snap_sem);
+out_vid_hdr:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_buf:
+	vfree(buf);
+	return err;
+}
+
+/**
+ * ubi_snap_write - write a snapshot if the flash has changed.
+ * @ubi: UBI device description object
+ *
+ * This function is called when the device is detached and on reboot, when
+ * the background thread is already stopped. Returns zero in case of success
+ * and a negative error code in case of failure.
+ */
+int ubi_snap_write(struct ubi_device *ubi)
+{
+	int err;
+
+	mutex_lock(&ubi->device_mutex);
+	err = snap_write(ubi);
+	mutex_unlock(&ubi->device_mutex);
+	return err;
+}
+
+/**
+ * ubi_snap_timeout - how long the background thread may sleep.
+ * @ubi: UBI device description object
+ *
+ * This function returns the number of jiffies left until the device has been
+ * idle long enough for a snapshot, or %MAX_SCHEDULE_TIMEOUT if no snapshot
+ * has to be written when idle.
+ */
+long ubi_snap_timeout(struct ubi_device *ubi)
+{
+	long left;
+
+	if (!ubi->snap_enabled || !snapshot_idle || !ubi->thread_enabled ||
+	    ubi->ro_mode || ubi->snap_valid_pnum != -1)
+		return MAX_SCHEDULE_TIMEOUT;
+
+	left = (long)(ubi->snap_mod_time + snapshot_idle * HZ - jiffies);
+	return left > 0 ? left : 0;
+}
+
+/**
+ * ubi_snap_idle - write a snapshot if the device is idle.
+ * @ubi: UBI device description object
+ *
+ * This function is called by the background thread when it wakes up with no
+ * pending works.
+ */
+void ubi_snap_idle(struct ubi_device *ubi)
+{
+	int err;
+
+	if (kthread_should_stop() || ubi->works_count ||
+	    ubi_snap_timeout(ubi) != 0)
+		return;
+
+	/* Do not retry right away if something goes wrong */
+	ubi->snap_mod_time = jiffies;
+	if (!mutex_trylock(&ubi->device_mutex))
+		return;
+	err = snap_write(ubi);
+	mutex_unlock(&ubi->device_mutex);
+	if (err)
+		ubi_warn("cannot write snapshot, error %d", err);
+}
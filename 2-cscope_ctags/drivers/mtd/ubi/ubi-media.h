@@ -312,6 +312,125 @@ struct ubi_vid_hdr {
 #define UBI_LAYOUT_VOLUME_NAME   "layout volume"
 #define UBI_LAYOUT_VOLUME_COMPAT UBI_COMPAT_REJECT
 
+/*
+ * The snapshot volume contains the fast attach snapshot. It is not a real
+ * volume - there is no volume table record and no &struct ubi_volume for it,
+ * and it consists of a single PEB which is only good for one attach. It has
+ * "delete" compatibility, so UBI implementations which do not know about
+ * snapshots simply erase it.
+ */
+#define UBI_SNAP_VOLUME_ID     (UBI_LAYOUT_VOLUME_ID + 1)
+#define UBI_SNAP_VOLUME_TYPE   UBI_VID_DYNAMIC
+#define UBI_SNAP_VOLUME_COMPAT UBI_COMPAT_DELETE
+
+/* Snapshot header magic number (ASCII "UBI$") */
+#define UBI_SNAP_HDR_MAGIC 0x55424924
+
+/* The version of the snapshot format */
+#define UBI_SNAP_VERSION 1
+
+/* The snapshot is always stored in one of the first PEBs of the device */
+#define UBI_SNAP_MAX_ANCHOR 64
+
+/*
+ * Physical eraseblock types used in the snapshot.
+ *
+ * @UBI_SNAP_PEB_FREE: the PEB is free and has a valid EC header
+ * @UBI_SNAP_PEB_USED: the PEB is mapped to a logical eraseblock
+ * @UBI_SNAP_PEB_ERASE: the PEB has to be erased
+ * @UBI_SNAP_PEB_BAD: the PEB is bad
+ * @UBI_SNAP_PEB_ALIEN: the PEB belongs to a "preserve" internal volume
+ */
+enum {
+	UBI_SNAP_PEB_FREE  = 1,
+	UBI_SNAP_PEB_USED  = 2,
+	UBI_SNAP_PEB_ERASE = 3,
+	UBI_SNAP_PEB_BAD   = 4,
+	UBI_SNAP_PEB_ALIEN = 5
+};
+
+/* Sizes of the snapshot structures */
+#define UBI_SNAP_HDR_SIZE sizeof(struct ubi_snap_hdr)
+#define UBI_SNAP_VOL_SIZE sizeof(struct ubi_snap_vol)
+#define UBI_SNAP_PEB_SIZE sizeof(struct ubi_snap_peb)
+
+/* Size of the snapshot header without the ending CRC */
+#define UBI_SNAP_HDR_SIZE_CRC (UBI_SNAP_HDR_SIZE - sizeof(__be32))
+
+/**
+ * struct ubi_snap_hdr - fast attach snapshot header.
+ * @magic: snapshot header magic number (%UBI_SNAP_HDR_MAGIC)
+ * @version: snapshot format version (%UBI_SNAP_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @peb_count: number of PEBs the snapshot describes
+ * @vol_count: number of &struct ubi_snap_vol records
+ * @data_size: how many bytes of records follow the header
+ * @data_crc: CRC32 checksum of the records
+ * @sqnum: highest sequence number in use when the snapshot was taken
+ * @padding2: reserved for future, zeroes
+ * @hdr_crc: snapshot header CRC checksum
+ *
+ * The snapshot describes the state of every physical eraseblock of the device
+ * so that attaching does not have to read the EC and VID headers of all of
+ * them. It is stored in the data area of a PEB belonging to the snapshot
+ * volume (%UBI_SNAP_VOLUME_ID) and consists of this header, @vol_count volume
+ * records, and @peb_count PEB records, one per PEB in PEB order.
+ *
+ * The snapshot is only valid as long as nothing on the flash has changed
+ * since it was written. Before the first flash modification which follows a
+ * snapshot, UBI programs the last minimal I/O unit of the snapshot PEB, which
+ * is otherwise left erased. A snapshot whose last minimal I/O unit is not
+ * erased is stale and is ignored.
+ */
+struct ubi_snap_hdr {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  peb_count;
+	__be32  vol_count;
+	__be32  data_size;
+	__be32  data_crc;
+	__be64  sqnum;
+	__u8    padding2[28];
+	__be32  hdr_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_snap_vol - a volume record in the snapshot.
+ * @vol_id: volume ID
+ * @used_ebs: number of used LEBs (static volumes only)
+ * @data_pad: how many bytes at the end of LEBs are not used
+ * @last_data_size: data size in the last used LEB (static volumes only)
+ * @vol_type: volume type (%UBI_VID_DYNAMIC or %UBI_VID_STATIC)
+ * @compat: compatibility flags of the volume
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_snap_vol {
+	__be32  vol_id;
+	__be32  used_ebs;
+	__be32  data_pad;
+	__be32  last_data_size;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding[2];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_snap_peb - a physical eraseblock record in the snapshot.
+ * @ec: erase counter
+ * @lnum: logical eraseblock number (used PEBs only)
+ * @type: PEB type (%UBI_SNAP_PEB_FREE, etc)
+ * @scrub: non-zero if the PEB has to be scrubbed
+ * @vol_idx: index of the volume record (used PEBs only)
+ */
+struct ubi_snap_peb {
+	__be32  ec;
+	__be32  lnum;
+	__u8    type;
+	__u8    scrub;
+	__be16  vol_idx;
+} __attribute__ ((packed));
+
 /* The maximum number of volumes per one UBI device */
 #define UBI_MAX_VOLUMES 128
 
@@ -346,11 +346,30 @@ struct ubi_wl_entry;
  * @move_to_put: if the "to" PEB was put
  * @works: list of pending works
  * @works_count: count of pending works
+ * @erase_pending: count of pending erasure works
+ * @free_count: count of physical eraseblocks in the @free tree
+ * @peb_waits: how many times 'ubi_wl_get_peb()' found no free physical
+ *             eraseblock and had to wait for one
+ * @peb_wait_works: how many works 'ubi_wl_get_peb()' had to do while waiting
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
  * @reboot_notifier: notifier to terminate background thread before rebooting
  *
+ * @snap_sem: taken in read mode by everything which changes the EBA tables,
+ *            and in write mode while a fast attach snapshot is taken
+ * @snap_mutex: serializes marking snapshots stale, protects @snap_valid_pnum
+ * @snap_mod_seq: incremented on every flash modification
+ * @snap_mod_time: time of the last flash modification (in jiffies)
+ * @snap_writer: the task writing a snapshot (its own writes do not count as
+ *               modifications)
+ * @snap_pnum: the PEB taken out of the WL sub-system for snapshots (%-1 if
+ *             none)
+ * @snap_valid_pnum: the PEB holding a snapshot which still describes the
+ *                   flash and has to be marked stale before it is modified
+ *                   (%-1 if none)
+ * @snap_enabled: if snapshots are written on this device
+ *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
  * @peb_size: physical eraseblock size
@@ -432,11 +451,25 @@ struct ubi_device {
 	int move_to_put;
 	struct list_head works;
 	int works_count;
+	int erase_pending;
+	int free_count;
+	unsigned int peb_waits;
+	unsigned int peb_wait_works;
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
 	struct notifier_block reboot_notifier;
 
+	/* Fast attach snapshot stuff */
+	struct rw_semaphore snap_sem;
+	struct mutex snap_mutex;
+	atomic_t snap_mod_seq;
+	unsigned long snap_mod_time;
+	struct task_struct *snap_writer;
+	int snap_pnum;
+	int snap_valid_pnum;
+	int snap_enabled;
+
 	/* I/O sub-system's stuff */
 	long long flash_size;
 	int peb_count;
@@ -523,6 +556,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -532,6 +566,8 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+int ubi_wl_get_snap_peb(struct ubi_device *ubi, int max_pnum);
+int ubi_wl_put_snap_peb(struct ubi_device *ubi, int pnum);
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -563,6 +599,32 @@ int ubi_notify_all(struct ubi_device *ubi, int ntype,
 		   struct notifier_block *nb);
 int ubi_enumerate_volumes(struct notifier_block *nb);
 
+/* snapshot.c */
+#ifdef CONFIG_MTD_UBI_SNAPSHOT
+struct ubi_scan_info *ubi_snap_scan(struct ubi_device *ubi);
+void ubi_snap_init(struct ubi_device *ubi, struct ubi_scan_info *si);
+void ubi_snap_reserve(struct ubi_device *ubi);
+int ubi_snap_write(struct ubi_device *ubi);
+int ubi_snap_invalidate(struct ubi_device *ubi);
+long ubi_snap_timeout(struct ubi_device *ubi);
+void ubi_snap_idle(struct ubi_device *ubi);
+#else
+static inline struct ubi_scan_info *ubi_snap_scan(struct ubi_device *ubi)
+{
+	return NULL;
+}
+static inline void ubi_snap_init(struct ubi_device *ubi,
+				 struct ubi_scan_info *si) {}
+static inline void ubi_snap_reserve(struct ubi_device *ubi) {}
+static inline int ubi_snap_write(struct ubi_device *ubi) { return 0; }
+static inline int ubi_snap_invalidate(struct ubi_device *ubi) { return 0; }
+static inline long ubi_snap_timeout(struct ubi_device *ubi)
+{
+	return MAX_SCHEDULE_TIMEOUT;
+}
+static inline void ubi_snap_idle(struct ubi_device *ubi) {}
+#endif
+
 /* kapi.c */
 void ubi_do_get_device_info(struct ubi_device *ubi, struct ubi_device_info *di);
 void ubi_do_get_volume_info(struct ubi_device *ubi, struct ubi_volume *vol,
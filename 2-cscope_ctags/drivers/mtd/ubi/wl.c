@@ -135,6 +135,13 @@
  */
 #define WL_FREE_MAX_DIFF (2*UBI_WL_THRESHOLD)
 
+/*
+ * Low-water mark of free physical eraseblocks. While there are fewer free
+ * PEBs than this, pending erasures are done before any other work, so that
+ * 'ubi_wl_get_peb()' finds a pre-erased PEB instead of waiting for one.
+ */
+#define WL_FREE_LOW_WATER CONFIG_MTD_UBI_FREE_LOW_WATER
+
 /*
  * Maximum number of consecutive background thread failures which is enough to
  * switch to read-only mode.
@@ -172,6 +179,9 @@ static int paranoid_check_in_pq(struct ubi_device *ubi, struct ubi_wl_entry *e);
 #define paranoid_check_in_pq(ubi, e) 0
 #endif
 
+static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
+			int cancel);
+
 /**
  * wl_tree_add - add a wear-leveling entry to a WL RB-tree.
  * @e: the wear-leveling entry to add
@@ -237,9 +247,20 @@ static int do_work(struct ubi_device *ubi)
 	}
 
 	wrk = list_entry(ubi->works.next, struct ubi_work, list);
+	if (ubi->free_count < WL_FREE_LOW_WATER && ubi->erase_pending &&
+	    wrk->func != &erase_worker) {
+		/* Running out of free PEBs, erasures go first */
+		list_for_each_entry(wrk, &ubi->works, list)
+			if (wrk->func == &erase_worker)
+				break;
+	}
 	list_del(&wrk->list);
 	ubi->works_count -= 1;
 	ubi_assert(ubi->works_count >= 0);
+	if (wrk->func == &erase_worker) {
+		ubi->erase_pending -= 1;
+		ubi_assert(ubi->erase_pending >= 0);
+	}
 	spin_unlock(&ubi->wl_lock);
 
 	/*
@@ -261,15 +282,19 @@ static int do_work(struct ubi_device *ubi)
  *
  * This function tries to make a free PEB by means of synchronous execution of
  * pending works. This may be needed if, for example the background thread is
- * disabled. Returns zero in case of success and a negative error code in case
- * of failure.
+ * disabled or cannot keep up. Since there are no free PEBs, 'do_work()' picks
+ * erasures first, so the caller does not have to wait for wear-leveling. The
+ * waits are counted in @ubi->peb_waits and @ubi->peb_wait_works. Returns zero
+ * in case of success and a negative error code in case of failure.
  */
 static int produce_free_peb(struct ubi_device *ubi)
 {
 	int err;
 
 	spin_lock(&ubi->wl_lock);
+	ubi->peb_waits += 1;
 	while (!ubi->free.rb_node) {
+		ubi->peb_wait_works += 1;
 		spin_unlock(&ubi->wl_lock);
 
 		dbg_wl("do one work synchronously");
@@ -456,6 +481,7 @@ retry:
 	 * be protected from being moved for some time.
 	 */
 	rb_erase(&e->u.rb, &ubi->free);
+	ubi->free_count -= 1;
 	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
 	prot_queue_add(ubi, e);
 	spin_unlock(&ubi->wl_lock);
@@ -613,14 +639,13 @@ static void schedule_ubi_work(struct ubi_device *ubi, struct ubi_work *wrk)
 	list_add_tail(&wrk->list, &ubi->works);
 	ubi_assert(ubi->works_count >= 0);
 	ubi->works_count += 1;
-	if (ubi->thread_enabled)
+	if (wrk->func == &erase_worker)
+		ubi->erase_pending += 1;
+	if (ubi->thread_enabled && ubi->bgt_thread)
 		wake_up_process(ubi->bgt_thread);
 	spin_unlock(&ubi->wl_lock);
 }
 
-static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
-			int cancel);
-
 /**
  * schedule_erase - schedule an erase work.
  * @ubi: UBI device description object
@@ -728,6 +753,7 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 
 	paranoid_check_in_wl_tree(e2, &ubi->free);
 	rb_erase(&e2->u.rb, &ubi->free);
+	ubi->free_count -= 1;
 	ubi->move_from = e1;
 	ubi->move_to = e2;
 	spin_unlock(&ubi->wl_lock);
@@ -1021,6 +1047,7 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 
 		spin_lock(&ubi->wl_lock);
 		wl_tree_add(e, &ubi->free);
+		ubi->free_count += 1;
 		spin_unlock(&ubi->wl_lock);
 
 		/*
@@ -1298,6 +1325,76 @@ int ubi_wl_flush(struct ubi_device *ubi)
 	return 0;
 }
 
+/**
+ * ubi_wl_get_snap_peb - get a physical eraseblock for a snapshot.
+ * @ubi: UBI device description object
+ * @max_pnum: the PEB has to be below this number
+ *
+ * This function picks the free physical eraseblock with the lowest erase
+ * counter below @max_pnum and takes it out of the WL sub-system, so it is
+ * neither handed out by 'ubi_wl_get_peb()' nor moved by wear-leveling until
+ * it is returned with 'ubi_wl_put_snap_peb()'. Returns the physical
+ * eraseblock number in case of success, %-ENOSPC if there is no suitable
+ * free physical eraseblock, and other negative error codes in case of
+ * failure.
+ */
+int ubi_wl_get_snap_peb(struct ubi_device *ubi, int max_pnum)
+{
+	int err;
+	struct rb_node *p;
+	struct ubi_wl_entry *e = NULL;
+
+	spin_lock(&ubi->wl_lock);
+	for (p = rb_first(&ubi->free); p; p = rb_next(p)) {
+		e = rb_entry(p, struct ubi_wl_entry, u.rb);
+		if (e->pnum < max_pnum)
+			break;
+	}
+	if (!p) {
+		spin_unlock(&ubi->wl_lock);
+		return -ENOSPC;
+	}
+
+	paranoid_check_in_wl_tree(e, &ubi->free);
+	rb_erase(&e->u.rb, &ubi->free);
+	ubi->free_count -= 1;
+	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
+	spin_unlock(&ubi->wl_lock);
+
+	err = ubi_dbg_check_all_ff(ubi, e->pnum, ubi->vid_hdr_aloffset,
+				   ubi->peb_size - ubi->vid_hdr_aloffset);
+	if (err) {
+		ubi_err("new PEB %d does not contain all 0xFF bytes", e->pnum);
+		return err > 0 ? -EINVAL : err;
+	}
+
+	return e->pnum;
+}
+
+/**
+ * ubi_wl_put_snap_peb - return a snapshot physical eraseblock.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock taken by 'ubi_wl_get_snap_peb()'
+ *
+ * This function schedules the physical eraseblock for erasure, after which
+ * it goes back to the pool of free physical eraseblocks. Returns zero in
+ * case of success and a negative error code in case of failure.
+ */
+int ubi_wl_put_snap_peb(struct ubi_device *ubi, int pnum)
+{
+	struct ubi_wl_entry *e;
+
+	dbg_wl("PEB %d", pnum);
+	ubi_assert(pnum >= 0);
+	ubi_assert(pnum < ubi->peb_count);
+
+	spin_lock(&ubi->wl_lock);
+	e = ubi->lookuptbl[pnum];
+	spin_unlock(&ubi->wl_lock);
+
+	return schedule_erase(ubi, e, 0);
+}
+
 /**
  * tree_destroy - destroy an RB-tree.
  * @root: the root of the tree to destroy
@@ -1356,7 +1453,8 @@ int ubi_thread(void *u)
 			       !ubi->thread_enabled) {
 			set_current_state(TASK_INTERRUPTIBLE);
 			spin_unlock(&ubi->wl_lock);
-			schedule();
+			schedule_timeout(ubi_snap_timeout(ubi));
+			ubi_snap_idle(ubi);
 			continue;
 		}
 		spin_unlock(&ubi->wl_lock);
@@ -1397,6 +1495,8 @@ static void cancel_pending(struct ubi_device *ubi)
 
 		wrk = list_entry(ubi->works.next, struct ubi_work, list);
 		list_del(&wrk->list);
+		if (wrk->func == &erase_worker)
+			ubi->erase_pending -= 1;
 		wrk->func(ubi, wrk, 1);
 		ubi->works_count -= 1;
 		ubi_assert(ubi->works_count >= 0);
@@ -1464,6 +1564,7 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 		e->ec = seb->ec;
 		ubi_assert(e->ec >= 0);
 		wl_tree_add(e, &ubi->free);
+		ubi->free_count += 1;
 		ubi->lookuptbl[e->pnum] = e;
 	}
 
@@ -1560,6 +1661,9 @@ void ubi_wl_close(struct ubi_device *ubi)
 	tree_destroy(&ubi->erroneous);
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
+	if (ubi->snap_pnum != -1)
+		kmem_cache_free(ubi_wl_entry_slab,
+				ubi->lookuptbl[ubi->snap_pnum]);
 	kfree(ubi->lookuptbl);
 }
 
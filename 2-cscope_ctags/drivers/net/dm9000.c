@@ -58,6 +58,15 @@ static int watchdog = 5000;
 module_param(watchdog, int, 0400);
 MODULE_PARM_DESC(watchdog, "transmit timeout in milliseconds");
 
+#ifdef CONFIG_DM9000_NAPI
+/*
+ * Default number of frames handled per NAPI poll, this can be changed
+ * at runtime through the ethtool rx-frames coalescing parameter.
+ */
+#define DM9000_NAPI_WEIGHT	16
+#define DM9000_NAPI_WEIGHT_MAX	64
+#endif
+
 /* DM9000 register address locking.
  *
  * The DM9000 uses an address register to control where data written
@@ -97,6 +106,7 @@ typedef struct board_info {
 	u16		queue_pkt_len;
 	u16		queue_start_addr;
 	u16		queue_ip_summed;
+	u16		tx_done_pending;	/* completions not yet reported */
 	u16		dbug_cnt;
 	u8		io_mode;		/* 0:word, 2:byte */
 	u8		phy_addr;
@@ -125,6 +135,10 @@ typedef struct board_info {
 	struct delayed_work phy_poll;
 	struct net_device  *ndev;
 
+#ifdef CONFIG_DM9000_NAPI
+	struct napi_struct napi;
+#endif
+
 	spinlock_t	lock;
 
 	struct mii_if_info mii;
@@ -516,6 +530,31 @@ static u32 dm9000_get_link(struct net_device *dev)
 	return ret;
 }
 
+#ifdef CONFIG_DM9000_NAPI
+static int dm9000_get_coalesce(struct net_device *dev,
+			       struct ethtool_coalesce *ec)
+{
+	board_info_t *dm = to_dm9000_board(dev);
+
+	ec->rx_max_coalesced_frames = dm->napi.weight;
+	return 0;
+}
+
+static int dm9000_set_coalesce(struct net_device *dev,
+			       struct ethtool_coalesce *ec)
+{
+	board_info_t *dm = to_dm9000_board(dev);
+
+	/* the chip has no rx timer, so only the frame count is supported */
+	if (ec->rx_max_coalesced_frames < 1 ||
+	    ec->rx_max_coalesced_frames > DM9000_NAPI_WEIGHT_MAX)
+		return -EINVAL;
+
+	dm->napi.weight = ec->rx_max_coalesced_frames;
+	return 0;
+}
+#endif
+
 #define DM_EEPROM_MAGIC		(0x444D394B)
 
 static int dm9000_get_eeprom_len(struct net_device *dev)
@@ -587,6 +626,10 @@ static const struct ethtool_ops dm9000_ethtool_ops = {
 	.set_rx_csum		= dm9000_set_rx_csum,
 	.get_tx_csum		= ethtool_op_get_tx_csum,
 	.set_tx_csum		= dm9000_set_tx_csum,
+#ifdef CONFIG_DM9000_NAPI
+	.get_coalesce		= dm9000_get_coalesce,
+	.set_coalesce		= dm9000_set_coalesce,
+#endif
 };
 
 static void dm9000_show_carrier(board_info_t *db,
@@ -767,6 +810,7 @@ dm9000_init_dm9000(struct net_device *dev)
 	/* Init Driver variable */
 	db->tx_pkt_cnt = 0;
 	db->queue_pkt_len = 0;
+	db->tx_done_pending = 0;
 	dev->trans_start = 0;
 }
 
@@ -816,29 +860,59 @@ static void dm9000_send_packet(struct net_device *dev,
 	iow(dm, DM9000_TCR, TCR_TXREQ);	/* Cleared after TX complete */
 }
 
+/*
+ * Copy a frame into the TX SRAM.
+ *
+ * The interrupt handler and the other holders of db->lock save and
+ * restore the index register, and on a uniprocessor nothing else can
+ * touch the chip while the transmit path runs with bottom halves
+ * disabled, so the copy is done with interrupts enabled and only the
+ * transmit kick is made under db->lock. On SMP the poll routine or the
+ * PHY access may run on another CPU, so the copy must hold the lock.
+ */
+static void dm9000_tx_copy(board_info_t *db, struct sk_buff *skb)
+{
+#ifdef CONFIG_SMP
+	unsigned long flags;
+
+	spin_lock_irqsave(&db->lock, flags);
+#endif
+	writeb(DM9000_MWCMD, db->io_addr);
+	(db->outblk)(db->io_data, skb->data, skb->len);
+#ifdef CONFIG_SMP
+	spin_unlock_irqrestore(&db->lock, flags);
+#endif
+}
+
 /*
  *  Hardware start transmission.
  *  Send a packet to media from the upper layer.
+ *
+ *  The TX SRAM holds two frames. While the first is on the wire the
+ *  second is copied in and left queued, to be kicked by dm9000_tx_done()
+ *  as soon as the first completes.
  */
 static int
 dm9000_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	unsigned long flags;
 	board_info_t *db = netdev_priv(dev);
+	u8 reg_save;
 
 	dm9000_dbg(db, 3, "%s:\n", __func__);
 
 	if (db->tx_pkt_cnt > 1)
 		return NETDEV_TX_BUSY;
 
-	spin_lock_irqsave(&db->lock, flags);
-
 	/* Move data to DM9000 TX RAM */
-	writeb(DM9000_MWCMD, db->io_addr);
-
-	(db->outblk)(db->io_data, skb->data, skb->len);
+	dm9000_tx_copy(db, skb);
 	dev->stats.tx_bytes += skb->len;
 
+	spin_lock_irqsave(&db->lock, flags);
+
+	/* Save previous register address */
+	reg_save = readb(db->io_addr);
+
 	db->tx_pkt_cnt++;
 	/* TX control: First packet immediately send, second packet queue */
 	if (db->tx_pkt_cnt == 1) {
@@ -850,6 +924,8 @@ dm9000_start_xmit(struct sk_buff *skb, struct net_device *dev)
 		netif_stop_queue(dev);
 	}
 
+	/* Restore previous register address */
+	writeb(reg_save, db->io_addr);
 	spin_unlock_irqrestore(&db->lock, flags);
 
 	/* free this SKB */
@@ -870,16 +946,22 @@ static void dm9000_tx_done(struct net_device *dev, board_info_t *db)
 	if (tx_status & (NSR_TX2END | NSR_TX1END)) {
 		/* One packet sent complete */
 		db->tx_pkt_cnt--;
-		dev->stats.tx_packets++;
 
 		if (netif_msg_tx_done(db))
 			dev_dbg(db->dev, "tx done, NSR %02x\n", tx_status);
 
-		/* Queue packet check & send */
+		/* Queue packet check & send, this is done straight from the
+		 * interrupt so that the wire does not go idle */
 		if (db->tx_pkt_cnt > 0)
 			dm9000_send_packet(dev, db->queue_ip_summed,
 					   db->queue_pkt_len);
+#ifdef CONFIG_DM9000_NAPI
+		/* reported to the stack from dm9000_poll() */
+		db->tx_done_pending++;
+#else
+		dev->stats.tx_packets++;
 		netif_wake_queue(dev);
+#endif
 	}
 }
 
@@ -890,10 +972,14 @@ struct dm9000_rxhdr {
 } __attribute__((__packed__));
 
 /*
- *  Received a packet and pass to upper layer
+ *  Fetch one received frame from the RX SRAM.
+ *
+ *  Must be called with db->lock held. Returns 0 if there is no frame
+ *  ready (or the chip has been stopped after a status error), otherwise
+ *  returns 1 and sets *skbp to the frame, or to NULL if it was dropped.
  */
-static void
-dm9000_rx(struct net_device *dev)
+static int
+dm9000_rx_frame(struct net_device *dev, struct sk_buff **skbp)
 {
 	board_info_t *db = netdev_priv(dev);
 	struct dm9000_rxhdr rxhdr;
@@ -902,98 +988,178 @@ dm9000_rx(struct net_device *dev)
 	bool GoodPacket;
 	int RxLen;
 
+	*skbp = NULL;
+
 	/* Check packet ready or not */
-	do {
-		ior(db, DM9000_MRCMDX);	/* Dummy read */
-
-		/* Get most updated data */
-		rxbyte = readb(db->io_data);
-
-		/* Status check: this byte must be 0 or 1 */
-		if (rxbyte & DM9000_PKT_ERR) {
-			dev_warn(db->dev, "status check fail: %d\n", rxbyte);
-			iow(db, DM9000_RCR, 0x00);	/* Stop Device */
-			iow(db, DM9000_ISR, IMR_PAR);	/* Stop INT request */
-			return;
-		}
+	ior(db, DM9000_MRCMDX);	/* Dummy read */
+
+	/* Get most updated data */
+	rxbyte = readb(db->io_data);
+
+	/* Status check: this byte must be 0 or 1 */
+	if (rxbyte & DM9000_PKT_ERR) {
+		dev_warn(db->dev, "status check fail: %d\n", rxbyte);
+		iow(db, DM9000_RCR, 0x00);	/* Stop Device */
+		iow(db, DM9000_ISR, IMR_PAR);	/* Stop INT request */
+		return 0;
+	}
 
-		if (!(rxbyte & DM9000_PKT_RDY))
-			return;
+	if (!(rxbyte & DM9000_PKT_RDY))
+		return 0;
+
+	/* A packet ready now  & Get status/length */
+	GoodPacket = true;
+	writeb(DM9000_MRCMD, db->io_addr);
 
-		/* A packet ready now  & Get status/length */
-		GoodPacket = true;
-		writeb(DM9000_MRCMD, db->io_addr);
+	(db->inblk)(db->io_data, &rxhdr, sizeof(rxhdr));
 
-		(db->inblk)(db->io_data, &rxhdr, sizeof(rxhdr));
+	RxLen = le16_to_cpu(rxhdr.RxLen);
 
-		RxLen = le16_to_cpu(rxhdr.RxLen);
+	if (netif_msg_rx_status(db))
+		dev_dbg(db->dev, "RX: status %02x, length %04x\n",
+			rxhdr.RxStatus, RxLen);
+
+	/* Packet Status check */
+	if (RxLen < 0x40) {
+		GoodPacket = false;
+		if (netif_msg_rx_err(db))
+			dev_dbg(db->dev, "RX: Bad Packet (runt)\n");
+	}
 
-		if (netif_msg_rx_status(db))
-			dev_dbg(db->dev, "RX: status %02x, length %04x\n",
-				rxhdr.RxStatus, RxLen);
+	if (RxLen > DM9000_PKT_MAX) {
+		dev_dbg(db->dev, "RST: RX Len:%x\n", RxLen);
+	}
 
-		/* Packet Status check */
-		if (RxLen < 0x40) {
-			GoodPacket = false;
+	/* rxhdr.RxStatus is identical to RSR register. */
+	if (rxhdr.RxStatus & (RSR_FOE | RSR_CE | RSR_AE |
+			      RSR_PLE | RSR_RWTO |
+			      RSR_LCS | RSR_RF)) {
+		GoodPacket = false;
+		if (rxhdr.RxStatus & RSR_FOE) {
 			if (netif_msg_rx_err(db))
-				dev_dbg(db->dev, "RX: Bad Packet (runt)\n");
+				dev_dbg(db->dev, "fifo error\n");
+			dev->stats.rx_fifo_errors++;
 		}
-
-		if (RxLen > DM9000_PKT_MAX) {
-			dev_dbg(db->dev, "RST: RX Len:%x\n", RxLen);
+		if (rxhdr.RxStatus & RSR_CE) {
+			if (netif_msg_rx_err(db))
+				dev_dbg(db->dev, "crc error\n");
+			dev->stats.rx_crc_errors++;
 		}
-
-		/* rxhdr.RxStatus is identical to RSR register. */
-		if (rxhdr.RxStatus & (RSR_FOE | RSR_CE | RSR_AE |
-				      RSR_PLE | RSR_RWTO |
-				      RSR_LCS | RSR_RF)) {
-			GoodPacket = false;
-			if (rxhdr.RxStatus & RSR_FOE) {
-				if (netif_msg_rx_err(db))
-					dev_dbg(db->dev, "fifo error\n");
-				dev->stats.rx_fifo_errors++;
-			}
-			if (rxhdr.RxStatus & RSR_CE) {
-				if (netif_msg_rx_err(db))
-					dev_dbg(db->dev, "crc error\n");
-				dev->stats.rx_crc_errors++;
-			}
-			if (rxhdr.RxStatus & RSR_RF) {
-				if (netif_msg_rx_err(db))
-					dev_dbg(db->dev, "length error\n");
-				dev->stats.rx_length_errors++;
-			}
+		if (rxhdr.RxStatus & RSR_RF) {
+			if (netif_msg_rx_err(db))
+				dev_dbg(db->dev, "length error\n");
+			dev->stats.rx_length_errors++;
 		}
+	}
 
-		/* Move data from DM9000 */
-		if (GoodPacket
-		    && ((skb = dev_alloc_skb(RxLen + 4)) != NULL)) {
-			skb_reserve(skb, 2);
-			rdptr = (u8 *) skb_put(skb, RxLen - 4);
-
-			/* Read received packet from RX SRAM */
-
-			(db->inblk)(db->io_data, rdptr, RxLen);
-			dev->stats.rx_bytes += RxLen;
-
-			/* Pass to upper layer */
-			skb->protocol = eth_type_trans(skb, dev);
-			if (db->rx_csum) {
-				if ((((rxbyte & 0x1c) << 3) & rxbyte) == 0)
-					skb->ip_summed = CHECKSUM_UNNECESSARY;
-				else
-					skb->ip_summed = CHECKSUM_NONE;
-			}
-			netif_rx(skb);
-			dev->stats.rx_packets++;
+	/* Move data from DM9000 */
+	if (GoodPacket
+	    && ((skb = dev_alloc_skb(RxLen + 4)) != NULL)) {
+		skb_reserve(skb, 2);
+		rdptr = (u8 *) skb_put(skb, RxLen - 4);
+
+		/* Read received packet from RX SRAM */
 
-		} else {
-			/* need to dump the packet's data */
+		(db->inblk)(db->io_data, rdptr, RxLen);
+		dev->stats.rx_bytes += RxLen;
 
-			(db->dumpblk)(db->io_data, RxLen);
+		skb->protocol = eth_type_trans(skb, dev);
+		if (db->rx_csum) {
+			if ((((rxbyte & 0x1c) << 3) & rxbyte) == 0)
+				skb->ip_summed = CHECKSUM_UNNECESSARY;
+			else
+				skb->ip_summed = CHECKSUM_NONE;
 		}
-	} while (rxbyte & DM9000_PKT_RDY);
+		dev->stats.rx_packets++;
+		*skbp = skb;
+	} else {
+		/* need to dump the packet's data */
+
+		(db->dumpblk)(db->io_data, RxLen);
+	}
+
+	return 1;
+}
+
+#ifdef CONFIG_DM9000_NAPI
+/*
+ *  NAPI poll routine, drain up to budget frames from the RX SRAM and
+ *  report the transmit completions seen since the last poll.
+ *
+ *  The lock is only held while a frame is moved out of the chip, so the
+ *  transmit path and the interrupt handler can run between frames, and
+ *  the frames are handed up with the lock released.
+ */
+static int dm9000_poll(struct napi_struct *napi, int budget)
+{
+	board_info_t *db = container_of(napi, board_info_t, napi);
+	struct net_device *dev = db->ndev;
+	struct sk_buff *skb;
+	unsigned long flags;
+	int work_done = 0;
+	int tx_done;
+	u8 reg_save;
+	int more;
+
+	while (work_done < budget) {
+		spin_lock_irqsave(&db->lock, flags);
+		reg_save = readb(db->io_addr);
+		more = dm9000_rx_frame(dev, &skb);
+		writeb(reg_save, db->io_addr);
+		spin_unlock_irqrestore(&db->lock, flags);
+
+		if (!more)
+			break;
+
+		if (skb)
+			napi_gro_receive(napi, skb);
+		work_done++;
+	}
+
+	spin_lock_irqsave(&db->lock, flags);
+
+	/* collect the transmit completions seen by the interrupt handler,
+	 * this must be done under the lock before napi_complete() so that
+	 * none can be left behind without a poll scheduled to report them */
+	tx_done = db->tx_done_pending;
+	db->tx_done_pending = 0;
+
+	if (work_done < budget) {
+		/* RX SRAM is empty, unmask the receive interrupt. Any frame
+		 * which arrived since the last check has latched ISR_PRS, so
+		 * it will raise a fresh interrupt once unmasked. */
+		napi_complete(napi);
+		db->imr_all |= IMR_PRM;
+		reg_save = readb(db->io_addr);
+		iow(db, DM9000_IMR, db->imr_all);
+		writeb(reg_save, db->io_addr);
+	}
+
+	spin_unlock_irqrestore(&db->lock, flags);
+
+	if (tx_done) {
+		dev->stats.tx_packets += tx_done;
+		netif_wake_queue(dev);
+	}
+
+	return work_done;
+}
+#else
+/*
+ *  Received a packet and pass to upper layer
+ */
+static void
+dm9000_rx(struct net_device *dev)
+{
+	struct sk_buff *skb;
+
+	while (dm9000_rx_frame(dev, &skb)) {
+		/* Pass to upper layer */
+		if (skb)
+			netif_rx(skb);
+	}
 }
+#endif
 
 static irqreturn_t dm9000_interrupt(int irq, void *dev_id)
 {
@@ -1023,14 +1189,23 @@ static irqreturn_t dm9000_interrupt(int irq, void *dev_id)
 	if (netif_msg_intr(db))
 		dev_dbg(db->dev, "interrupt status %02x\n", int_status);
 
-	/* Received the coming packet */
-	if (int_status & ISR_PRS)
-		dm9000_rx(dev);
-
 	/* Trnasmit Interrupt check */
 	if (int_status & ISR_PTS)
 		dm9000_tx_done(dev, db);
 
+	/* Received the coming packet, or completions to report */
+#ifdef CONFIG_DM9000_NAPI
+	if (((int_status & ISR_PRS) || db->tx_done_pending) &&
+	    napi_schedule_prep(&db->napi)) {
+		/* keep RX masked until the poll has drained the SRAM */
+		db->imr_all &= ~IMR_PRM;
+		__napi_schedule(&db->napi);
+	}
+#else
+	if (int_status & ISR_PRS)
+		dm9000_rx(dev);
+#endif
+
 	if (db->type != TYPE_DM9000E) {
 		if (int_status & ISR_LNKCHNG) {
 			/* fire a link-change request */
@@ -1092,6 +1267,9 @@ dm9000_open(struct net_device *dev)
 	/* Init driver variable */
 	db->dbug_cnt = 0;
 
+#ifdef CONFIG_DM9000_NAPI
+	napi_enable(&db->napi);
+#endif
 	mii_check_media(&db->mii, netif_msg_link(db), 1);
 	netif_start_queue(dev);
 	
@@ -1231,6 +1409,9 @@ dm9000_stop(struct net_device *ndev)
 
 	netif_stop_queue(ndev);
 	netif_carrier_off(ndev);
+#ifdef CONFIG_DM9000_NAPI
+	napi_disable(&db->napi);
+#endif
 
 	/* free interrupt */
 	free_irq(ndev->irq, ndev);
@@ -1291,6 +1472,9 @@ dm9000_probe(struct platform_device *pdev)
 	mutex_init(&db->addr_lock);
 
 	INIT_DELAYED_WORK(&db->phy_poll, dm9000_poll_work);
+#ifdef CONFIG_DM9000_NAPI
+	netif_napi_add(ndev, &db->napi, dm9000_poll, DM9000_NAPI_WEIGHT);
+#endif
 
 	db->addr_res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	db->data_res = platform_get_resource(pdev, IORESOURCE_MEM, 1);
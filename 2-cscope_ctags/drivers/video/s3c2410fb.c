@@ -25,6 +25,10 @@
 #include <linux/platform_device.h>
 #include <linux/clk.h>
 #include <linux/cpufreq.h>
+#include <linux/moduleparam.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/uaccess.h>
 
 #include <asm/io.h>
 #include <asm/div64.h>
@@ -49,6 +53,16 @@ static int debug	= 0;
 
 #define dprintk(msg...)	if (debug) { printk(KERN_DEBUG "s3c2410fb: " msg); }
 
+#ifndef FBIO_WAITFORVSYNC
+#define FBIO_WAITFORVSYNC	_IOW('F', 0x20, __u32)
+#endif
+
+/* screens worth of video memory, yres_virtual can be up to buffers * yres */
+static unsigned int buffers = 1;
+module_param(buffers, uint, 0444);
+MODULE_PARM_DESC(buffers,
+		 "number of screen buffers for page flipping (1-4, default 1)");
+
 /* useful functions */
 
 static int is_s3c2412(struct s3c2410fb_info *fbi)
@@ -56,6 +70,28 @@ static int is_s3c2412(struct s3c2410fb_info *fbi)
 	return (fbi->drv_type == DRV_S3C2412);
 }
 
+/* s3c2410fb_calc_lcdaddr
+ *
+ * work out LCDSADDR1/2 for a screen starting at line yoffset
+ */
+static int s3c2410fb_calc_lcdaddr(struct fb_info *info, unsigned int yoffset,
+				  unsigned long *saddr1, unsigned long *saddr2)
+{
+	unsigned long start, end;
+
+	start  = info->fix.smem_start;
+	start += info->fix.line_length * yoffset;
+	end    = start + info->fix.line_length * info->var.yres;
+
+	/* LCDBANK (A[30:22]) is shared by the whole screen */
+	if ((start ^ (end - 1)) >> 22)
+		return -EINVAL;
+
+	*saddr1 = start >> 1;
+	*saddr2 = end >> 1;
+	return 0;
+}
+
 /* s3c2410fb_set_lcdaddr
  *
  * initialise lcd controller address pointers
@@ -66,10 +102,11 @@ static void s3c2410fb_set_lcdaddr(struct fb_info *info)
 	struct s3c2410fb_info *fbi = info->par;
 	void __iomem *regs = fbi->io;
 
-	saddr1  = info->fix.smem_start >> 1;
-	saddr2  = info->fix.smem_start;
-	saddr2 += info->fix.line_length * info->var.yres;
-	saddr2 >>= 1;
+	if (s3c2410fb_calc_lcdaddr(info, info->var.yoffset, &saddr1, &saddr2)) {
+		info->var.yoffset = 0;
+		s3c2410fb_calc_lcdaddr(info, 0, &saddr1, &saddr2);
+	}
+	fbi->pan_pending = 0;
 
 	saddr3 = S3C2410_OFFSIZE(0) |
 		 S3C2410_PAGEWIDTH((info->fix.line_length / 2) & 0x3ff);
@@ -147,9 +184,14 @@ static int s3c2410fb_check_var(struct fb_var_screeninfo *var,
 		return -EINVAL;
 	}
 
-	/* it is always the size as the display */
+	/* the width is always that of the display, the height may cover
+	 * several screens for page flipping */
 	var->xres_virtual = display->xres;
-	var->yres_virtual = display->yres;
+	var->yres_virtual = clamp_t(u32, var->yres_virtual, display->yres,
+			info->fix.smem_len / (display->xres * display->bpp / 8));
+	var->xoffset = 0;
+	if (var->yoffset > var->yres_virtual - display->yres)
+		var->yoffset = 0;
 	var->height = display->height;
 	var->width = display->width;
 
@@ -444,12 +486,21 @@ static int s3c2410fb_set_par(struct fb_info *info)
 	return 0;
 }
 
+/* unmask the frame sync interrupt, called with interrupts disabled */
+static void s3c2410fb_enable_frsync(struct s3c2410fb_info *fbi)
+{
+	void __iomem *irq_base = fbi->irq_base;
+	unsigned long irqen;
+
+	irqen = readl(irq_base + S3C24XX_LCDINTMSK);
+	irqen &= ~S3C2410_LCDINT_FRSYNC;
+	writel(irqen, irq_base + S3C24XX_LCDINTMSK);
+}
+
 static void schedule_palette_update(struct s3c2410fb_info *fbi,
 				    unsigned int regno, unsigned int val)
 {
 	unsigned long flags;
-	unsigned long irqen;
-	void __iomem *irq_base = fbi->irq_base;
 
 	local_irq_save(flags);
 
@@ -457,16 +508,94 @@ static void schedule_palette_update(struct s3c2410fb_info *fbi,
 
 	if (!fbi->palette_ready) {
 		fbi->palette_ready = 1;
-
-		/* enable IRQ */
-		irqen = readl(irq_base + S3C24XX_LCDINTMSK);
-		irqen &= ~S3C2410_LCDINT_FRSYNC;
-		writel(irqen, irq_base + S3C24XX_LCDINTMSK);
+		s3c2410fb_enable_frsync(fbi);
 	}
 
 	local_irq_restore(flags);
 }
 
+/* s3c2410fb_wait_for_vsync
+ *
+ * sleep until the next frame sync interrupt
+ */
+static int s3c2410fb_wait_for_vsync(struct s3c2410fb_info *fbi)
+{
+	unsigned long flags;
+	unsigned int count;
+	int ret;
+
+	local_irq_save(flags);
+	count = fbi->vsync_count;
+	s3c2410fb_enable_frsync(fbi);
+	local_irq_restore(flags);
+
+	ret = wait_event_interruptible_timeout(fbi->vsync_wait,
+					       count != fbi->vsync_count,
+					       HZ / 10);
+	if (ret < 0)
+		return ret;
+	if (ret == 0)
+		return -ETIMEDOUT;
+	return 0;
+}
+
+/*
+ *      s3c2410fb_pan_display - Flip to another screen in the virtual area.
+ *      @var: the new offsets
+ *      @info: frame buffer structure that represents a single frame buffer
+ *
+ *	The new start address is latched by the frame sync interrupt so the
+ *	controller never switches in the middle of a frame. Callers asking
+ *	for FB_ACTIVATE_VBL are put to sleep until the flip happened.
+ */
+static int s3c2410fb_pan_display(struct fb_var_screeninfo *var,
+				 struct fb_info *info)
+{
+	struct s3c2410fb_info *fbi = info->par;
+	unsigned long saddr1, saddr2;
+	unsigned long flags;
+	int ret;
+
+	if (var->xoffset != 0)
+		return -EINVAL;
+
+	ret = s3c2410fb_calc_lcdaddr(info, var->yoffset, &saddr1, &saddr2);
+	if (ret)
+		return ret;
+
+	dprintk("pan to line %d, LCDSADDR1 = 0x%08lx\n", var->yoffset, saddr1);
+
+	local_irq_save(flags);
+	fbi->pan_saddr1 = saddr1;
+	fbi->pan_saddr2 = saddr2;
+	fbi->pan_pending = 1;
+	s3c2410fb_enable_frsync(fbi);
+	local_irq_restore(flags);
+
+	if (var->activate & FB_ACTIVATE_VBL)
+		return s3c2410fb_wait_for_vsync(fbi);
+
+	return 0;
+}
+
+static int s3c2410fb_ioctl(struct fb_info *info, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct s3c2410fb_info *fbi = info->par;
+	u32 crtc;
+
+	switch (cmd) {
+	case FBIO_WAITFORVSYNC:
+		if (get_user(crtc, (u32 __user *)arg))
+			return -EFAULT;
+		if (crtc != 0)
+			return -ENODEV;
+		return s3c2410fb_wait_for_vsync(fbi);
+	}
+
+	return -ENOTTY;
+}
+
 /* from pxafb.c */
 static inline unsigned int chan_to_field(unsigned int chan,
 					 struct fb_bitfield *bf)
@@ -618,6 +747,8 @@ static struct fb_ops s3c2410fb_ops = {
 	.fb_set_par	= s3c2410fb_set_par,
 	.fb_blank	= s3c2410fb_blank,
 	.fb_setcolreg	= s3c2410fb_setcolreg,
+	.fb_pan_display	= s3c2410fb_pan_display,
+	.fb_ioctl	= s3c2410fb_ioctl,
 	.fb_fillrect	= cfb_fillrect,
 	.fb_copyarea	= cfb_copyarea,
 	.fb_imageblit	= cfb_imageblit,
@@ -754,6 +885,24 @@ static irqreturn_t s3c2410fb_irq(int irq, void *dev_id)
 		if (fbi->palette_ready)
 			s3c2410fb_write_palette(fbi);
 
+		if (fbi->pan_pending) {
+			writel(fbi->pan_saddr1, fbi->io + S3C2410_LCDSADDR1);
+			writel(fbi->pan_saddr2, fbi->io + S3C2410_LCDSADDR2);
+			fbi->pan_pending = 0;
+		}
+
+		fbi->vsync_count++;
+		wake_up_interruptible(&fbi->vsync_wait);
+
+		/* nothing left to do on the next frame, stay quiet */
+		if (!fbi->palette_ready && !waitqueue_active(&fbi->vsync_wait)) {
+			unsigned long irqen;
+
+			irqen = readl(irq_base + S3C24XX_LCDINTMSK);
+			irqen |= S3C2410_LCDINT_FRSYNC;
+			writel(irqen, irq_base + S3C24XX_LCDINTMSK);
+		}
+
 		writel(S3C2410_LCDINT_FRSYNC, irq_base + S3C24XX_LCDINTPND);
 		writel(S3C2410_LCDINT_FRSYNC, irq_base + S3C24XX_LCDSRCPND);
 	}
@@ -894,7 +1043,7 @@ static int __init s3c24xxfb_probe(struct platform_device *pdev,
 	fbinfo->fix.type	    = FB_TYPE_PACKED_PIXELS;
 	fbinfo->fix.type_aux	    = 0;
 	fbinfo->fix.xpanstep	    = 0;
-	fbinfo->fix.ypanstep	    = 0;
+	fbinfo->fix.ypanstep	    = 1;
 	fbinfo->fix.ywrapstep	    = 0;
 	fbinfo->fix.accel	    = FB_ACCEL_NONE;
 
@@ -910,6 +1059,9 @@ static int __init s3c24xxfb_probe(struct platform_device *pdev,
 	for (i = 0; i < 256; i++)
 		info->palette_buffer[i] = PALETTE_BUFF_CLEAR;
 
+	info->buffers = clamp_t(unsigned int, buffers, 1, 4);
+	init_waitqueue_head(&info->vsync_wait);
+
 	ret = request_irq(irq, s3c2410fb_irq, IRQF_DISABLED, pdev->name, info);
 	if (ret) {
 		dev_err(&pdev->dev, "cannot get irq %d - err %d\n", irq, ret);
@@ -941,6 +1093,7 @@ static int __init s3c24xxfb_probe(struct platform_device *pdev,
 		if (fbinfo->fix.smem_len < smem_len)
 			fbinfo->fix.smem_len = smem_len;
 	}
+	fbinfo->fix.smem_len *= info->buffers;
 
 	/* Initialize video memory */
 	ret = s3c2410fb_map_video_memory(fbinfo);
@@ -955,6 +1108,7 @@ static int __init s3c24xxfb_probe(struct platform_device *pdev,
 	fbinfo->var.xres = display->xres;
 	fbinfo->var.yres = display->yres;
 	fbinfo->var.bits_per_pixel = display->bpp;
+	fbinfo->var.yres_virtual = display->yres * info->buffers;
 
 	s3c2410fb_init_registers(fbinfo);
 
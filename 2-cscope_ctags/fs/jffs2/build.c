@@ -14,6 +14,7 @@
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/mtd/mtd.h>
+#include <linux/ktime.h>
 #include "nodelist.h"
 
 static void jffs2_build_remove_unlinked_inode(struct jffs2_sb_info *,
@@ -329,6 +330,7 @@ int jffs2_do_mount_fs(struct jffs2_sb_info *c)
 	int ret;
 	int i;
 	int size;
+	ktime_t start;
 
 	c->free_size = c->flash_size;
 	c->nr_blocks = c->flash_size / c->sector_size;
@@ -368,7 +370,10 @@ int jffs2_do_mount_fs(struct jffs2_sb_info *c)
 	if (ret)
 		goto out_free;
 
-	if (jffs2_build_filesystem(c)) {
+	start = ktime_get();
+	ret = jffs2_build_filesystem(c);
+	c->mount_stats.build_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret) {
 		dbg_fsbuild("build_fs failed\n");
 		jffs2_free_ino_caches(c);
 		jffs2_free_raw_node_refs(c);
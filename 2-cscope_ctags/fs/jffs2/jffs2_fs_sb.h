@@ -27,6 +27,19 @@
 #define JFFS2_SB_FLAG_BUILDING 4 /* File system building is in progress */
 
 struct jffs2_inodirty;
+struct dentry;
+
+/* Where the time of the mount-time scan went, exported in debugfs */
+struct jffs2_mount_stats {
+	uint64_t build_ns;	/* Scan plus building the inode caches */
+	uint64_t scan_ns;	/* jffs2_scan_medium() */
+	uint64_t sum_read_ns;	/* Summary read-ahead I/O, in its own thread */
+	uint64_t sum_wait_ns;	/* Scan waiting for the summary read-ahead */
+	uint64_t sum_parse_ns;	/* Parsing summary nodes */
+	uint32_t blocks;	/* Eraseblocks scanned */
+	uint32_t sum_blocks;	/* Eraseblocks built from their summary */
+	uint32_t sum_readahead;	/* Summaries found by the read-ahead */
+};
 
 /* A struct for the overall file system control.  Pointers to
    jffs2_sb_info structs are named `c' in the source code.
@@ -124,6 +137,10 @@ struct jffs2_sb_info {
 #endif
 
 	struct jffs2_summary *summary;		/* Summary information */
+	struct jffs2_mount_stats mount_stats;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *debugfs_dir;
+#endif
 
 #ifdef CONFIG_JFFS2_FS_XATTR
 #define XATTRINDEX_HASHSIZE	(57)
@@ -16,6 +16,7 @@
 #include <linux/pagemap.h>
 #include <linux/crc32.h>
 #include <linux/compiler.h>
+#include <linux/ktime.h>
 #include "nodelist.h"
 #include "summary.h"
 #include "debug.h"
@@ -35,7 +36,8 @@
 static uint32_t pseudo_random;
 
 static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
-				  unsigned char *buf, uint32_t buf_size, struct jffs2_summary *s);
+				  unsigned char *buf, uint32_t buf_size, struct jffs2_summary *s,
+				  struct jffs2_sum_readahead *ra);
 
 /* These helper functions _must_ increase ofs and also do the dirty/used space accounting.
  * Returning an error will abort the mount - bad checksums etc. should just mark the space
@@ -93,6 +95,8 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	unsigned char *flashbuf = NULL;
 	uint32_t buf_size = 0;
 	struct jffs2_summary *s = NULL; /* summary info collected by the scan process */
+	struct jffs2_sum_readahead *ra = NULL;
+	ktime_t start = ktime_get();
 #ifndef __ECOS
 	size_t pointlen;
 
@@ -134,6 +138,11 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 			ret = -ENOMEM;
 			goto out;
 		}
+
+		/* Read the summaries ahead while we parse them, unless
+		   the flash is mapped and there's nothing to read */
+		if (buf_size)
+			ra = jffs2_sum_readahead_start(c);
 	}
 
 	for (i=0; i<c->nr_blocks; i++) {
@@ -145,7 +154,8 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 		jffs2_sum_reset_collected(s);
 
 		ret = jffs2_scan_eraseblock(c, jeb, buf_size?flashbuf:(flashbuf+jeb->offset),
-						buf_size, s);
+						buf_size, s, ra);
+		c->mount_stats.blocks++;
 
 		if (ret < 0)
 			goto out;
@@ -264,6 +274,7 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	}
 	ret = 0;
  out:
+	jffs2_sum_readahead_stop(ra);
 	if (buf_size)
 		kfree(flashbuf);
 #ifndef __ECOS
@@ -273,6 +284,7 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	if (s)
 		kfree(s);
 
+	c->mount_stats.scan_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 	return ret;
 }
 
@@ -430,7 +442,8 @@ static int jffs2_scan_xref_node(struct jffs2_sb_info *c, struct jffs2_eraseblock
 /* Called with 'buf_size == 0' if buf is in fact a pointer _directly_ into
    the flash, XIP-style */
 static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
-				  unsigned char *buf, uint32_t buf_size, struct jffs2_summary *s) {
+				  unsigned char *buf, uint32_t buf_size, struct jffs2_summary *s,
+				  struct jffs2_sum_readahead *ra) {
 	struct jffs2_unknown_node *node;
 	struct jffs2_unknown_node crcnode;
 	uint32_t ofs, prevofs;
@@ -473,6 +486,8 @@ static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblo
 		struct jffs2_sum_marker *sm;
 		void *sumptr = NULL;
 		uint32_t sumlen;
+		int sumra = -EAGAIN;
+		ktime_t start;
 	      
 		if (!buf_size) {
 			/* XIP case. Just look, point at the summary if it's there */
@@ -481,6 +496,9 @@ static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblo
 				sumptr = buf + je32_to_cpu(sm->offset);
 				sumlen = c->sector_size - je32_to_cpu(sm->offset);
 			}
+		} else if ((sumra = jffs2_sum_readahead_get(ra, jeb, &sumptr, &sumlen)) >= 0) {
+			/* The read-ahead thread already read the summary, or
+			   found there is none */
 		} else {
 			/* If NAND flash, read a whole page of it. Else just the end */
 			if (c->wbuf_pagesize)
@@ -521,9 +539,13 @@ static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblo
 		}
 
 		if (sumptr) {
+			start = ktime_get();
 			err = jffs2_sum_scan_sumnode(c, jeb, sumptr, sumlen, &pseudo_random);
+			c->mount_stats.sum_parse_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+			if (err > 0)
+				c->mount_stats.sum_blocks++;
 
-			if (buf_size && sumlen > buf_size)
+			if (sumra > 0 || (buf_size && sumlen > buf_size))
 				kfree(sumptr);
 			/* If it returns with a real error, bail. 
 			   If it returns positive, that's a block classification
@@ -18,6 +18,10 @@
 #include <linux/crc32.h>
 #include <linux/compiler.h>
 #include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
 #include "nodelist.h"
 #include "debug.h"
 
@@ -664,6 +668,247 @@ crc_err:
 	return 0;
 }
 
+/* Summary read-ahead for the mount-time scan.
+
+   jffs2_scan_medium() used to read the summary at the end of each
+   eraseblock and parse it before moving on to the next one, so flash
+   reads and parsing never overlapped. A kernel thread now runs up to
+   JFFS2_SUM_RA_WINDOW eraseblocks ahead of the scan, reading their
+   summaries into kmalloc'd buffers, while the scan parses the ones
+   already read. Eraseblocks have to be consumed in ascending order.
+
+   Anything unusual (read errors, bad blocks, implausible summary
+   offsets) is left for jffs2_scan_eraseblock() to read and handle
+   itself, exactly as without the read-ahead. */
+
+#define JFFS2_SUM_RA_WINDOW	8
+
+#define JFFS2_SUM_RA_NONE	0	/* No summary in this eraseblock */
+#define JFFS2_SUM_RA_FOUND	1	/* Summary read into the slot buffer */
+#define JFFS2_SUM_RA_FAILED	2	/* Let the scan read it itself */
+
+struct jffs2_sum_ra_slot {
+	int state;
+	uint32_t sumlen;
+	void *sumptr;
+};
+
+struct jffs2_sum_readahead {
+	struct jffs2_sb_info *c;
+	struct task_struct *task;
+	spinlock_t lock;
+	wait_queue_head_t wait;
+	uint32_t next_read;		/* Next eraseblock to read ahead */
+	uint32_t next_scan;		/* Next eraseblock to hand to the scan */
+	uint32_t tail_len;		/* Bytes read from the end of each block */
+	unsigned char *tail;
+	struct jffs2_sum_ra_slot slot[JFFS2_SUM_RA_WINDOW];
+};
+
+static int jffs2_sum_ra_read(struct jffs2_sum_readahead *ra, struct jffs2_eraseblock *jeb,
+			     void **sumptr, uint32_t *sumlen)
+{
+	struct jffs2_sb_info *c = ra->c;
+	struct jffs2_sum_marker *sm;
+	uint32_t ofs, len;
+	size_t retlen;
+	void *buf;
+	int ret;
+
+	if (c->mtd->block_isbad && c->mtd->block_isbad(c->mtd, jeb->offset))
+		return JFFS2_SUM_RA_FAILED;
+
+	ret = jffs2_flash_read(c, jeb->offset + c->sector_size - ra->tail_len,
+			       ra->tail_len, &retlen, ra->tail);
+	if (ret || retlen != ra->tail_len)
+		return JFFS2_SUM_RA_FAILED;
+
+	sm = (void *)ra->tail + ra->tail_len - sizeof(*sm);
+	if (je32_to_cpu(sm->magic) != JFFS2_SUM_MAGIC)
+		return JFFS2_SUM_RA_NONE;
+
+	ofs = je32_to_cpu(sm->offset);
+	if (ofs >= c->sector_size || c->sector_size - ofs > MAX_SUMMARY_SIZE)
+		return JFFS2_SUM_RA_FAILED;
+	len = c->sector_size - ofs;
+
+	buf = kmalloc(len, GFP_KERNEL);
+	if (!buf)
+		return JFFS2_SUM_RA_FAILED;
+
+	if (len <= ra->tail_len) {
+		memcpy(buf, ra->tail + ra->tail_len - len, len);
+	} else {
+		memcpy(buf + len - ra->tail_len, ra->tail, ra->tail_len);
+		ret = jffs2_flash_read(c, jeb->offset + ofs, len - ra->tail_len,
+				       &retlen, buf);
+		if (ret || retlen != len - ra->tail_len) {
+			kfree(buf);
+			return JFFS2_SUM_RA_FAILED;
+		}
+	}
+
+	*sumptr = buf;
+	*sumlen = len;
+	return JFFS2_SUM_RA_FOUND;
+}
+
+static int jffs2_sum_ra_room(struct jffs2_sum_readahead *ra)
+{
+	int ret;
+
+	spin_lock(&ra->lock);
+	ret = ra->next_read < ra->c->nr_blocks &&
+		ra->next_read < ra->next_scan + JFFS2_SUM_RA_WINDOW;
+	spin_unlock(&ra->lock);
+	return ret;
+}
+
+static int jffs2_sum_ra_ready(struct jffs2_sum_readahead *ra)
+{
+	int ret;
+
+	spin_lock(&ra->lock);
+	ret = ra->next_read > ra->next_scan;
+	spin_unlock(&ra->lock);
+	return ret;
+}
+
+static int jffs2_sum_ra_thread(void *_ra)
+{
+	struct jffs2_sum_readahead *ra = _ra;
+	struct jffs2_sb_info *c = ra->c;
+	struct jffs2_sum_ra_slot *slot;
+	void *sumptr = NULL;
+	uint32_t sumlen = 0;
+	ktime_t start;
+	int state;
+
+	for (;;) {
+		wait_event(ra->wait, kthread_should_stop() || jffs2_sum_ra_room(ra));
+		if (kthread_should_stop())
+			break;
+
+		/* Only this thread moves next_read, and the slot is free */
+		start = ktime_get();
+		state = jffs2_sum_ra_read(ra, &c->blocks[ra->next_read], &sumptr, &sumlen);
+		c->mount_stats.sum_read_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		spin_lock(&ra->lock);
+		slot = &ra->slot[ra->next_read % JFFS2_SUM_RA_WINDOW];
+		slot->state = state;
+		slot->sumptr = state == JFFS2_SUM_RA_FOUND ? sumptr : NULL;
+		slot->sumlen = sumlen;
+		ra->next_read++;
+		spin_unlock(&ra->lock);
+		wake_up(&ra->wait);
+	}
+	return 0;
+}
+
+/* Start reading summaries ahead of the scan. Returns NULL if that isn't
+   possible, in which case the scan just reads them itself. */
+struct jffs2_sum_readahead *jffs2_sum_readahead_start(struct jffs2_sb_info *c)
+{
+	struct jffs2_sum_readahead *ra;
+
+	ra = kzalloc(sizeof(*ra), GFP_KERNEL);
+	if (!ra)
+		return NULL;
+
+	/* Same amount as jffs2_scan_eraseblock() reads to find the marker */
+	ra->tail_len = c->wbuf_pagesize ? c->wbuf_pagesize : sizeof(struct jffs2_sum_marker);
+	ra->tail = kmalloc(ra->tail_len, GFP_KERNEL);
+	if (!ra->tail) {
+		kfree(ra);
+		return NULL;
+	}
+
+	ra->c = c;
+	spin_lock_init(&ra->lock);
+	init_waitqueue_head(&ra->wait);
+
+	ra->task = kthread_run(jffs2_sum_ra_thread, ra, "jffs2_sumra_mtd%d", c->mtd->index);
+	if (IS_ERR(ra->task)) {
+		JFFS2_WARNING("Can't start summary read-ahead thread, error %ld\n",
+			      PTR_ERR(ra->task));
+		kfree(ra->tail);
+		kfree(ra);
+		return NULL;
+	}
+
+	return ra;
+}
+
+/* Hand the read-ahead result for jeb to the scan. Returns 1 with the
+   summary in *sumptr (to be kfree'd by the caller), 0 if the eraseblock
+   has no summary, or -EAGAIN if the caller has to read it itself.
+   Results for eraseblocks skipped by the scan are dropped. */
+int jffs2_sum_readahead_get(struct jffs2_sum_readahead *ra, struct jffs2_eraseblock *jeb,
+			    void **sumptr, uint32_t *sumlen)
+{
+	struct jffs2_sb_info *c;
+	struct jffs2_sum_ra_slot *slot;
+	uint32_t n, i, len;
+	ktime_t start;
+	void *buf;
+	int state;
+
+	if (!ra)
+		return -EAGAIN;
+
+	c = ra->c;
+	n = jeb - c->blocks;
+	if (n < ra->next_scan)
+		return -EAGAIN;
+
+	start = ktime_get();
+	do {
+		wait_event(ra->wait, jffs2_sum_ra_ready(ra));
+
+		spin_lock(&ra->lock);
+		i = ra->next_scan++;
+		slot = &ra->slot[i % JFFS2_SUM_RA_WINDOW];
+		state = slot->state;
+		buf = slot->sumptr;
+		len = slot->sumlen;
+		slot->sumptr = NULL;
+		spin_unlock(&ra->lock);
+		wake_up(&ra->wait);
+
+		if (i != n)
+			kfree(buf);
+	} while (i != n);
+	c->mount_stats.sum_wait_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	switch (state) {
+	case JFFS2_SUM_RA_FOUND:
+		c->mount_stats.sum_readahead++;
+		*sumptr = buf;
+		*sumlen = len;
+		return 1;
+	case JFFS2_SUM_RA_NONE:
+		return 0;
+	default:
+		return -EAGAIN;
+	}
+}
+
+void jffs2_sum_readahead_stop(struct jffs2_sum_readahead *ra)
+{
+	int i;
+
+	if (!ra)
+		return;
+
+	kthread_stop(ra->task);
+
+	for (i = 0; i < JFFS2_SUM_RA_WINDOW; i++)
+		kfree(ra->slot[i].sumptr);
+	kfree(ra->tail);
+	kfree(ra);
+}
+
 /* Write summary data to flash - helper function for jffs2_sum_write_sumnode() */
 
 static int jffs2_sum_write_data(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
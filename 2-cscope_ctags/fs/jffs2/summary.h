@@ -167,6 +167,8 @@ struct jffs2_sum_marker
 	jint32_t magic; 	/* == JFFS2_SUM_MAGIC */
 };
 
+struct jffs2_sum_readahead;
+
 #define JFFS2_SUMMARY_FRAME_SIZE (sizeof(struct jffs2_raw_summary) + sizeof(struct jffs2_sum_marker))
 
 #ifdef CONFIG_JFFS2_SUMMARY	/* SUMMARY SUPPORT ENABLED */
@@ -186,6 +188,10 @@ int jffs2_sum_add_inode_mem(struct jffs2_summary *s, struct jffs2_raw_inode *ri,
 int jffs2_sum_add_dirent_mem(struct jffs2_summary *s, struct jffs2_raw_dirent *rd, uint32_t ofs);
 int jffs2_sum_add_xattr_mem(struct jffs2_summary *s, struct jffs2_raw_xattr *rx, uint32_t ofs);
 int jffs2_sum_add_xref_mem(struct jffs2_summary *s, struct jffs2_raw_xref *rr, uint32_t ofs);
+struct jffs2_sum_readahead *jffs2_sum_readahead_start(struct jffs2_sb_info *c);
+int jffs2_sum_readahead_get(struct jffs2_sum_readahead *ra, struct jffs2_eraseblock *jeb,
+			    void **sumptr, uint32_t *sumlen);
+void jffs2_sum_readahead_stop(struct jffs2_sum_readahead *ra);
 int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
 			   struct jffs2_raw_summary *summary, uint32_t sumlen,
 			   uint32_t *pseudo_random);
@@ -206,6 +212,9 @@ int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb
 #define jffs2_sum_add_dirent_mem(a,b,c)
 #define jffs2_sum_add_xattr_mem(a,b,c)
 #define jffs2_sum_add_xref_mem(a,b,c)
+#define jffs2_sum_readahead_start(a) (NULL)
+#define jffs2_sum_readahead_get(a,b,c,d) (-EAGAIN)
+#define jffs2_sum_readahead_stop(a)
 #define jffs2_sum_scan_sumnode(a,b,c,d,e) (0)
 
 #endif /* CONFIG_JFFS2_SUMMARY */
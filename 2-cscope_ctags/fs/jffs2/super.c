@@ -24,6 +24,7 @@
 #include <linux/ctype.h>
 #include <linux/namei.h>
 #include <linux/exportfs.h>
+#include <linux/debugfs.h>
 #include "compr.h"
 #include "nodelist.h"
 
@@ -142,12 +143,52 @@ static const struct super_operations jffs2_super_operations =
 	.sync_fs =	jffs2_sync_fs,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *jffs2_debugfs_root;
+
+/* Export the mount-time scan breakdown in <debugfs>/jffs2/mtdN/ */
+static void jffs2_debugfs_add(struct jffs2_sb_info *c)
+{
+	struct jffs2_mount_stats *st = &c->mount_stats;
+	struct dentry *dir;
+	char name[16];
+
+	if (!jffs2_debugfs_root)
+		return;
+
+	snprintf(name, sizeof(name), "mtd%d", c->mtd->index);
+	dir = debugfs_create_dir(name, jffs2_debugfs_root);
+	if (!dir)
+		return;
+
+	debugfs_create_u64("build_ns", S_IRUGO, dir, &st->build_ns);
+	debugfs_create_u64("scan_ns", S_IRUGO, dir, &st->scan_ns);
+	debugfs_create_u64("sum_read_ns", S_IRUGO, dir, &st->sum_read_ns);
+	debugfs_create_u64("sum_wait_ns", S_IRUGO, dir, &st->sum_wait_ns);
+	debugfs_create_u64("sum_parse_ns", S_IRUGO, dir, &st->sum_parse_ns);
+	debugfs_create_u32("blocks", S_IRUGO, dir, &st->blocks);
+	debugfs_create_u32("sum_blocks", S_IRUGO, dir, &st->sum_blocks);
+	debugfs_create_u32("sum_readahead", S_IRUGO, dir, &st->sum_readahead);
+	c->debugfs_dir = dir;
+}
+
+static void jffs2_debugfs_remove(struct jffs2_sb_info *c)
+{
+	debugfs_remove_recursive(c->debugfs_dir);
+	c->debugfs_dir = NULL;
+}
+#else
+static inline void jffs2_debugfs_add(struct jffs2_sb_info *c) { }
+static inline void jffs2_debugfs_remove(struct jffs2_sb_info *c) { }
+#endif
+
 /*
  * fill in the superblock
  */
 static int jffs2_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct jffs2_sb_info *c;
+	int ret;
 
 	D1(printk(KERN_DEBUG "jffs2_get_sb_mtd():"
 		  " New superblock for device %d (\"%s\")\n",
@@ -177,7 +218,10 @@ static int jffs2_fill_super(struct super_block *sb, void *data, int silent)
 #ifdef CONFIG_JFFS2_FS_POSIX_ACL
 	sb->s_flags |= MS_POSIXACL;
 #endif
-	return jffs2_do_fill_super(sb, data, silent);
+	ret = jffs2_do_fill_super(sb, data, silent);
+	if (!ret)
+		jffs2_debugfs_add(c);
+	return ret;
 }
 
 static int jffs2_get_sb(struct file_system_type *fs_type,
@@ -194,6 +238,8 @@ static void jffs2_put_super (struct super_block *sb)
 
 	D2(printk(KERN_DEBUG "jffs2: jffs2_put_super()\n"));
 
+	jffs2_debugfs_remove(c);
+
 	lock_kernel();
 
 	if (sb->s_dirt)
@@ -287,6 +333,9 @@ static int __init init_jffs2_fs(void)
 		printk(KERN_ERR "JFFS2 error: Failed to register filesystem\n");
 		goto out_slab;
 	}
+#ifdef CONFIG_DEBUG_FS
+	jffs2_debugfs_root = debugfs_create_dir("jffs2", NULL);
+#endif
 	return 0;
 
  out_slab:
@@ -301,6 +350,9 @@ static int __init init_jffs2_fs(void)
 static void __exit exit_jffs2_fs(void)
 {
 	unregister_filesystem(&jffs2_fs_type);
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(jffs2_debugfs_root);
+#endif
 	jffs2_destroy_slab_caches();
 	jffs2_compressors_exit();
 	kmem_cache_destroy(jffs2_inode_cachep);
@@ -42,6 +42,13 @@
  * have been packed with it, these because of locality-of-reference may be read
  * in the near future. Temporarily caching them ensures they are available for
  * near future access without requiring an additional read and decompress.
+ *
+ * The number of metadata and fragment cache entries can be set at mount
+ * time (metadata_cache= and fragment_cache=), filesystems with many small
+ * files packed into fragments benefit from a larger fragment cache.  Cached
+ * blocks are found through a small hash table rather than by scanning every
+ * entry, and cache hits, misses and waits are reported in
+ * /proc/self/mountstats.
  */
 
 #include <linux/fs.h>
@@ -53,12 +60,34 @@
 #include <linux/wait.h>
 #include <linux/zlib.h>
 #include <linux/pagemap.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
 
+/*
+ * Find block in the cache hash table, returning NULL if not present.  Called
+ * with the cache lock held.
+ */
+static struct squashfs_cache_entry *squashfs_cache_lookup(
+	struct squashfs_cache *cache, u64 block)
+{
+	struct squashfs_cache_entry *entry;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(entry, node,
+			&cache->hash[hash_64(block, cache->hash_bits)], hash)
+		if (entry->block == block)
+			return entry;
+
+	return NULL;
+}
+
+
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
  * and decompress it from disk.
@@ -72,16 +101,15 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 	spin_lock(&cache->lock);
 
 	while (1) {
-		for (i = 0; i < cache->entries; i++)
-			if (cache->entry[i].block == block)
-				break;
+		entry = squashfs_cache_lookup(cache, block);
 
-		if (i == cache->entries) {
+		if (entry == NULL) {
 			/*
 			 * Block not in cache, if all cache entries are used
 			 * go to sleep waiting for one to become available.
 			 */
 			if (cache->unused == 0) {
+				cache->waits++;
 				cache->num_waiters++;
 				spin_unlock(&cache->lock);
 				wait_event(cache->wait_queue, cache->unused);
@@ -106,11 +134,15 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			entry = &cache->entry[i];
 
 			/*
-			 * Initialise choosen cache entry, and fill it in from
-			 * disk.
+			 * Initialise choosen cache entry, rehash it under the
+			 * new block, and fill it in from disk.
 			 */
+			cache->misses++;
 			cache->unused--;
+			hlist_del_init(&entry->hash);
 			entry->block = block;
+			hlist_add_head(&entry->hash,
+				&cache->hash[hash_64(block, cache->hash_bits)]);
 			entry->refcount = 1;
 			entry->pending = 1;
 			entry->num_waiters = 0;
@@ -148,7 +180,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		 * previously unused there's one less cache entry available
 		 * for reuse.
 		 */
-		entry = &cache->entry[i];
+		cache->hits++;
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
@@ -169,7 +201,8 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 
 out:
 	TRACE("Got %s %d, start block %lld, refcount %d, error %d\n",
-		cache->name, i, entry->block, entry->refcount, entry->error);
+		cache->name, (int) (entry - cache->entry), entry->block,
+		entry->refcount, entry->error);
 
 	if (entry->error)
 		ERROR("Unable to read %s cache entry [%llx]\n", cache->name,
@@ -220,6 +253,7 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 		}
 	}
 
+	kfree(cache->hash);
 	kfree(cache->entry);
 	kfree(cache);
 }
@@ -247,6 +281,18 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		goto cleanup;
 	}
 
+	/*
+	 * Size the hash table to the next power of two of the number of
+	 * entries, with at least two buckets.
+	 */
+	cache->hash_bits = entries > 2 ? ilog2(roundup_pow_of_two(entries)) : 1;
+	cache->hash = kcalloc(1 << cache->hash_bits, sizeof(*(cache->hash)),
+		GFP_KERNEL);
+	if (cache->hash == NULL) {
+		ERROR("Failed to allocate %s cache\n", name);
+		goto cleanup;
+	}
+
 	cache->next_blk = 0;
 	cache->unused = entries;
 	cache->entries = entries;
@@ -262,6 +308,7 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		struct squashfs_cache_entry *entry = &cache->entry[i];
 
 		init_waitqueue_head(&cache->entry[i].wait_queue);
+		INIT_HLIST_NODE(&entry->hash);
 		entry->cache = cache;
 		entry->block = SQUASHFS_INVALID_BLK;
 		entry->data = kcalloc(cache->pages, sizeof(void *), GFP_KERNEL);
@@ -287,6 +334,25 @@ cleanup:
 }
 
 
+/*
+ * Report the cache size and hit/miss statistics in /proc/self/mountstats.
+ */
+void squashfs_cache_stats(struct seq_file *m, struct squashfs_cache *cache)
+{
+	unsigned long hits, misses, waits;
+
+	spin_lock(&cache->lock);
+	hits = cache->hits;
+	misses = cache->misses;
+	waits = cache->waits;
+	spin_unlock(&cache->lock);
+
+	seq_printf(m, " %s_cache=%d %s_hits=%lu %s_misses=%lu %s_waits=%lu",
+		cache->name, cache->entries, cache->name, hits, cache->name,
+		misses, cache->name, waits);
+}
+
+
 /*
  * Copy upto length bytes from cache entry to buffer starting at offset bytes
  * into the cache entry.  If there's not length bytes then copy the number of
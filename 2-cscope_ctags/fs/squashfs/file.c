@@ -38,6 +38,10 @@
  * Larger files use multiple slots, with 1.75 TiB files using all 8 slots.
  * The index cache is designed to be memory efficient, and by default uses
  * 16 KiB.
+ *
+ * Datablocks are normally decompressed straight into the page cache pages
+ * they cover.  The read_page cache is only used when some of these pages
+ * are not available, and for fragments.
  */
 
 #include <linux/fs.h>
@@ -372,6 +376,83 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * instead of into a read_page cache entry which is then copied out.  All
+ * the other pages of the block must be grabbed without blocking, must not
+ * be uptodate already and must be directly addressable, otherwise -EAGAIN
+ * is returned and the caller falls back to reading through the cache.  On
+ * success all pages, including the one being read, are uptodate and
+ * unlocked.  On other errors the page being read is left locked.
+ */
+static int squashfs_readpage_direct(struct page *target, u64 block, int bsize)
+{
+	struct inode *inode = target->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target->index & ~mask;
+	int end_index = start_index | mask;
+	int i, n, pages, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kcalloc(pages, sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target->index) ? target :
+			grab_cache_page_nowait(target->mapping, n);
+		if (page[i] == NULL || PageUptodate(page[i]) ||
+				PageHighMem(page[i]))
+			goto release;
+		pageaddr[i] = page_address(page[i]);
+	}
+
+	/*
+	 * Limit the block to the pages we have, a block larger than that is
+	 * corrupt (only the last block of a file covers fewer pages).
+	 */
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	if (res < 0)
+		goto release;
+
+	for (i = 0; i < pages; i++) {
+		n = res - (i << PAGE_CACHE_SHIFT);
+		if (n < (int) PAGE_CACHE_SIZE)
+			memset(pageaddr[i] + max(n, 0), 0,
+				PAGE_CACHE_SIZE - max(n, 0));
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target)
+			page_cache_release(page[i]);
+	}
+
+	res = 0;
+	goto out;
+
+release:
+	for (i = 0; i < pages; i++)
+		if (page[i] && page[i] != target) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -411,8 +492,18 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock, straight into the
+			 * page cache if possible.
 			 */
+			int res = squashfs_readpage_direct(page, block, bsize);
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN) {
+				ERROR("Unable to read page, block %llx, size %x"
+					"\n", block, bsize);
+				goto error_out;
+			}
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
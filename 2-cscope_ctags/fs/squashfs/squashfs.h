@@ -50,6 +50,10 @@ extern struct squashfs_cache_entry *squashfs_get_fragment(struct super_block *,
 extern struct squashfs_cache_entry *squashfs_get_datablock(struct super_block *,
 				u64, int);
 extern int squashfs_read_table(struct super_block *, void *, u64, int);
+extern void squashfs_cache_stats(struct seq_file *, struct squashfs_cache *);
+
+/* decompressor.c */
+extern const struct squashfs_decompressor *squashfs_lookup_decompressor(int);
 
 /* export.c */
 extern __le64 *squashfs_read_inode_lookup_table(struct super_block *, u64,
@@ -70,6 +74,15 @@ extern struct inode *squashfs_iget(struct super_block *, long long,
 				unsigned int);
 extern int squashfs_read_inode(struct inode *, long long);
 
+/* stream.c */
+extern struct squashfs_stream *squashfs_get_stream(struct squashfs_sb_info *);
+extern void squashfs_put_stream(struct squashfs_sb_info *,
+				struct squashfs_stream *);
+extern int squashfs_streams_init(struct squashfs_sb_info *, int);
+extern void squashfs_streams_delete(struct squashfs_sb_info *);
+extern void squashfs_streams_stats(struct seq_file *,
+				struct squashfs_sb_info *);
+
 /*
  * Inodes and files operations
  */
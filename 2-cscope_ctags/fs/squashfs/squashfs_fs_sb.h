@@ -23,6 +23,8 @@
  * squashfs_fs_sb.h
  */
 
+#include <linux/ktime.h>
+
 #include "squashfs_fs.h"
 
 struct squashfs_cache {
@@ -33,9 +35,14 @@ struct squashfs_cache {
 	int			unused;
 	int			block_size;
 	int			pages;
+	int			hash_bits;
+	unsigned long		hits;
+	unsigned long		misses;
+	unsigned long		waits;
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
+	struct hlist_head	*hash;
 };
 
 struct squashfs_cache_entry {
@@ -47,11 +54,19 @@ struct squashfs_cache_entry {
 	int			error;
 	int			num_waiters;
 	wait_queue_head_t	wait_queue;
+	struct hlist_node	hash;
 	struct squashfs_cache	*cache;
 	void			**data;
 };
 
+struct squashfs_stream {
+	struct list_head	list;
+	ktime_t			start;
+	void			*stream;
+};
+
 struct squashfs_sb_info {
+	const struct squashfs_decompressor *decompressor;
 	int			devblksize;
 	int			devblksize_log2;
 	struct squashfs_cache	*block_cache;
@@ -61,10 +76,16 @@ struct squashfs_sb_info {
 	__le64			*id_table;
 	__le64			*fragment_index;
 	unsigned int		*fragment_index_2;
-	struct mutex		read_data_mutex;
 	struct mutex		meta_index_mutex;
 	struct meta_index	*meta_index;
-	z_stream		stream;
+	spinlock_t		stream_lock;
+	struct list_head	stream_list;
+	wait_queue_head_t	stream_wait;
+	int			streams;
+	unsigned long		decompressions;
+	unsigned long		stream_waits;
+	u64			stream_wait_ns;
+	u64			decompress_ns;
 	__le64			*inode_lookup_table;
 	u64			inode_table;
 	u64			directory_table;
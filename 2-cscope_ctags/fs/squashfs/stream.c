@@ -0,0 +1,181 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * Copyright (c) 2002, 2003, 2004, 2005, 2006, 2007, 2008
+ * Phillip Lougher <phillip@lougher.demon.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * stream.c
+ */
+
+/*
+ * This file implements the pool of decompressor streams.  Each mounted
+ * filesystem owns a fixed number of streams (by default one per online
+ * cpu, or as set by the threads= mount option), so independent block reads
+ * decompress concurrently instead of queueing on one stream.  A reader which
+ * finds every stream busy sleeps until one is returned.
+ *
+ * The time spent waiting for a stream and decompressing is accounted per
+ * filesystem, and reported in /proc/self/mountstats.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/list.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+#include "decompressor.h"
+
+/*
+ * Take an idle stream from the pool, sleeping until one is available.
+ */
+struct squashfs_stream *squashfs_get_stream(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream;
+	ktime_t start;
+
+	spin_lock(&msblk->stream_lock);
+	if (list_empty(&msblk->stream_list)) {
+		msblk->stream_waits++;
+		start = ktime_get();
+		do {
+			spin_unlock(&msblk->stream_lock);
+			wait_event(msblk->stream_wait,
+				!list_empty(&msblk->stream_list));
+			spin_lock(&msblk->stream_lock);
+		} while (list_empty(&msblk->stream_list));
+		msblk->stream_wait_ns += ktime_to_ns(ktime_sub(ktime_get(),
+			start));
+	}
+
+	stream = list_first_entry(&msblk->stream_list, struct squashfs_stream,
+		list);
+	list_del(&stream->list);
+	spin_unlock(&msblk->stream_lock);
+
+	stream->start = ktime_get();
+	return stream;
+}
+
+
+/*
+ * Return a stream to the pool, and account the time it was used for.
+ */
+void squashfs_put_stream(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *stream)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), stream->start));
+
+	spin_lock(&msblk->stream_lock);
+	list_add(&stream->list, &msblk->stream_list);
+	msblk->decompressions++;
+	msblk->decompress_ns += ns;
+	spin_unlock(&msblk->stream_lock);
+
+	wake_up(&msblk->stream_wait);
+}
+
+
+/*
+ * Free all streams of the pool.  Called at unmount, or on mount failure,
+ * when no stream is in use.
+ */
+void squashfs_streams_delete(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream, *next;
+
+	if (msblk->streams == 0)
+		return;
+
+	list_for_each_entry_safe(stream, next, &msblk->stream_list, list) {
+		list_del(&stream->list);
+		squashfs_decompressor_free(msblk, stream->stream);
+		kfree(stream);
+	}
+}
+
+
+/*
+ * Allocate the pool of streams.  A failure to allocate all of them is not
+ * fatal as long as at least one stream exists.
+ */
+int squashfs_streams_init(struct squashfs_sb_info *msblk, int streams)
+{
+	struct squashfs_stream *stream;
+	int i;
+
+	spin_lock_init(&msblk->stream_lock);
+	INIT_LIST_HEAD(&msblk->stream_list);
+	init_waitqueue_head(&msblk->stream_wait);
+
+	for (i = 0; i < streams; i++) {
+		stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+		if (stream == NULL)
+			break;
+
+		stream->stream = squashfs_decompressor_init(msblk);
+		if (stream->stream == NULL) {
+			kfree(stream);
+			break;
+		}
+
+		list_add(&stream->list, &msblk->stream_list);
+	}
+
+	if (i == 0)
+		return -ENOMEM;
+
+	if (i < streams)
+		WARNING("Only %d of %d decompressor streams allocated\n", i,
+			streams);
+
+	msblk->streams = i;
+	return 0;
+}
+
+
+/*
+ * Report the pool statistics in /proc/self/mountstats.
+ */
+void squashfs_streams_stats(struct seq_file *m,
+	struct squashfs_sb_info *msblk)
+{
+	unsigned long decompressions, waits;
+	u64 wait_ns, decompress_ns;
+
+	spin_lock(&msblk->stream_lock);
+	decompressions = msblk->decompressions;
+	waits = msblk->stream_waits;
+	wait_ns = msblk->stream_wait_ns;
+	decompress_ns = msblk->decompress_ns;
+	spin_unlock(&msblk->stream_lock);
+
+	seq_printf(m, "streams=%d decompressions=%lu stream_waits=%lu "
+		"stream_wait_us=%llu decompress_us=%llu", msblk->streams,
+		decompressions, waits,
+		(unsigned long long) div_u64(wait_ns, NSEC_PER_USEC),
+		(unsigned long long) div_u64(decompress_ns, NSEC_PER_USEC));
+}
@@ -35,18 +35,94 @@
 #include <linux/pagemap.h>
 #include <linux/init.h>
 #include <linux/module.h>
-#include <linux/zlib.h>
 #include <linux/magic.h>
+#include <linux/parser.h>
+#include <linux/seq_file.h>
+#include <linux/cpumask.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
+#include "decompressor.h"
 
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
 
-static int supported_squashfs_filesystem(short major, short minor, short comp)
+/* Upper limit of the threads= mount option */
+#define SQUASHFS_MAX_STREAMS 64
+
+/* Upper limit of the metadata_cache= and fragment_cache= mount options */
+#define SQUASHFS_MAX_CACHED 256
+
+struct squashfs_mount_opts {
+	int	threads;
+	int	metadata_cache;
+	int	fragment_cache;
+};
+
+enum {
+	Opt_threads, Opt_metadata_cache, Opt_fragment_cache, Opt_err
+};
+
+static const match_table_t tokens = {
+	{Opt_threads, "threads=%u"},
+	{Opt_metadata_cache, "metadata_cache=%u"},
+	{Opt_fragment_cache, "fragment_cache=%u"},
+	{Opt_err, NULL}
+};
+
+static int squashfs_parse_options(char *options,
+	struct squashfs_mount_opts *opts)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p;
+	int token, n;
+
+	if (options == NULL)
+		return 0;
+
+	while ((p = strsep(&options, ",")) != NULL) {
+		if (!*p)
+			continue;
+
+		token = match_token(p, tokens, args);
+		switch (token) {
+		case Opt_threads:
+			if (match_int(&args[0], &n) || n < 1 ||
+					n > SQUASHFS_MAX_STREAMS) {
+				ERROR("threads= must be between 1 and %d\n",
+					SQUASHFS_MAX_STREAMS);
+				return -EINVAL;
+			}
+			opts->threads = n;
+			break;
+		case Opt_metadata_cache:
+		case Opt_fragment_cache:
+			if (match_int(&args[0], &n) || n < 1 ||
+					n > SQUASHFS_MAX_CACHED) {
+				ERROR("Cache size must be between 1 and %d\n",
+					SQUASHFS_MAX_CACHED);
+				return -EINVAL;
+			}
+			if (token == Opt_metadata_cache)
+				opts->metadata_cache = n;
+			else
+				opts->fragment_cache = n;
+			break;
+		default:
+			/* Squashfs used to ignore all options, keep doing so */
+			WARNING("Ignoring unrecognised mount option \"%s\"\n",
+				p);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int supported_squashfs_filesystem(struct squashfs_sb_info *msblk,
+	short major, short minor, short id)
 {
 	if (major < SQUASHFS_MAJOR) {
 		ERROR("Major/Minor mismatch, older Squashfs %d.%d "
@@ -59,8 +135,12 @@ static int supported_squashfs_filesystem(short major, short minor, short comp)
 		return -EINVAL;
 	}
 
-	if (comp != ZLIB_COMPRESSION)
+	msblk->decompressor = squashfs_lookup_decompressor(id);
+	if (!msblk->decompressor->supported) {
+		ERROR("Filesystem uses \"%s\" compression.  This is not "
+			"supported\n", msblk->decompressor->name);
 		return -EINVAL;
+	}
 
 	return 0;
 }
@@ -76,10 +156,19 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	unsigned short flags;
 	unsigned int fragments;
 	u64 lookup_table_start;
+	struct squashfs_mount_opts opts = {
+		.threads = min_t(int, num_online_cpus(), SQUASHFS_MAX_STREAMS),
+		.metadata_cache = SQUASHFS_CACHED_BLKS,
+		.fragment_cache = SQUASHFS_CACHED_FRAGMENTS
+	};
 	int err;
 
 	TRACE("Entered squashfs_fill_superblock\n");
 
+	err = squashfs_parse_options(data, &opts);
+	if (err)
+		return err;
+
 	sb->s_fs_info = kzalloc(sizeof(*msblk), GFP_KERNEL);
 	if (sb->s_fs_info == NULL) {
 		ERROR("Failed to allocate squashfs_sb_info\n");
@@ -87,13 +176,6 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	}
 	msblk = sb->s_fs_info;
 
-	msblk->stream.workspace = kmalloc(zlib_inflate_workspacesize(),
-		GFP_KERNEL);
-	if (msblk->stream.workspace == NULL) {
-		ERROR("Failed to allocate zlib workspace\n");
-		goto failure;
-	}
-
 	sblk = kzalloc(sizeof(*sblk), GFP_KERNEL);
 	if (sblk == NULL) {
 		ERROR("Failed to allocate squashfs_super_block\n");
@@ -103,7 +185,6 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, BLOCK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
 
 	/*
@@ -131,7 +212,8 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	/* Check the MAJOR & MINOR versions and compression type */
-	err = supported_squashfs_filesystem(le16_to_cpu(sblk->s_major),
+	err = supported_squashfs_filesystem(msblk,
+			le16_to_cpu(sblk->s_major),
 			le16_to_cpu(sblk->s_minor),
 			le16_to_cpu(sblk->compression));
 	if (err < 0)
@@ -205,13 +287,20 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	err = -ENOMEM;
 
+	if (squashfs_streams_init(msblk, opts.threads))
+		goto failed_mount;
+
 	msblk->block_cache = squashfs_cache_init("metadata",
-			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
+			opts.metadata_cache, SQUASHFS_METADATA_SIZE);
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
-	/* Allocate read_page block */
-	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
+	/*
+	 * Allocate read_page blocks, one per decompressor stream so that
+	 * datablock reads of different files do not wait for each other
+	 */
+	msblk->read_page = squashfs_cache_init("data", msblk->streams,
+		msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -231,7 +320,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto allocate_lookup_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		opts.fragment_cache, msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -295,14 +384,14 @@ failed_mount:
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
-	kfree(msblk->stream.workspace);
+	squashfs_streams_delete(msblk);
 	kfree(sb->s_fs_info);
 	sb->s_fs_info = NULL;
 	kfree(sblk);
 	return err;
 
 failure:
-	kfree(msblk->stream.workspace);
+	squashfs_streams_delete(msblk);
 	kfree(sb->s_fs_info);
 	sb->s_fs_info = NULL;
 	return -ENOMEM;
@@ -330,6 +419,32 @@ static int squashfs_statfs(struct dentry *dentry, struct kstatfs *buf)
 }
 
 
+static int squashfs_show_options(struct seq_file *m, struct vfsmount *mnt)
+{
+	struct squashfs_sb_info *msblk = mnt->mnt_sb->s_fs_info;
+
+	seq_printf(m, ",threads=%d", msblk->streams);
+	seq_printf(m, ",metadata_cache=%d", msblk->block_cache->entries);
+	if (msblk->fragment_cache)
+		seq_printf(m, ",fragment_cache=%d",
+			msblk->fragment_cache->entries);
+	return 0;
+}
+
+
+static int squashfs_show_stats(struct seq_file *m, struct vfsmount *mnt)
+{
+	struct squashfs_sb_info *msblk = mnt->mnt_sb->s_fs_info;
+
+	squashfs_streams_stats(m, msblk);
+	squashfs_cache_stats(m, msblk->block_cache);
+	squashfs_cache_stats(m, msblk->read_page);
+	if (msblk->fragment_cache)
+		squashfs_cache_stats(m, msblk->fragment_cache);
+	return 0;
+}
+
+
 static int squashfs_remount(struct super_block *sb, int *flags, char *data)
 {
 	*flags |= MS_RDONLY;
@@ -349,7 +464,7 @@ static void squashfs_put_super(struct super_block *sb)
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
-		kfree(sbi->stream.workspace);
+		squashfs_streams_delete(sbi);
 		kfree(sb->s_fs_info);
 		sb->s_fs_info = NULL;
 	}
@@ -449,7 +564,9 @@ static const struct super_operations squashfs_super_ops = {
 	.destroy_inode = squashfs_destroy_inode,
 	.statfs = squashfs_statfs,
 	.put_super = squashfs_put_super,
-	.remount_fs = squashfs_remount
+	.remount_fs = squashfs_remount,
+	.show_options = squashfs_show_options,
+	.show_stats = squashfs_show_stats
 };
 
 module_init(init_squashfs_fs);
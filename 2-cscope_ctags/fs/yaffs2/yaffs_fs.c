@@ -51,6 +51,11 @@ extern const char *yaffs_guts_c_version;
 #include <linux/interrupt.h>
 #include <linux/string.h>
 #include <linux/ctype.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/kthread.h>
+#include <linux/jiffies.h>
+#include <linux/delay.h>
 
 #include "asm/div64.h"
 
@@ -115,6 +120,7 @@ static uint32_t YCALCBLOCKS(uint64_t partition_size, uint32_t block_size)
 
 #include "yportenv.h"
 #include "yaffs_guts.h"
+#include "yaffs_nand.h"
 
 #include <linux/mtd/mtd.h>
 #include "yaffs_mtdif.h"
@@ -125,11 +131,37 @@ unsigned int yaffs_traceMask = YAFFS_TRACE_BAD_BLOCKS | YAFFS_TRACE_ALWAYS;
 unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 
+/* Background garbage collection tuning */
+unsigned int yaffs_bg_gc = 1;			/* 0 disables the gc thread */
+unsigned int yaffs_bg_gc_idle_ms = 500;		/* idle time before gc starts */
+unsigned int yaffs_bg_gc_live_pct = 25;		/* max live chunks when relaxed */
+unsigned int yaffs_bg_gc_urgent_pct = 75;	/* ... and when short of space */
+
+/* Runtime checkpointing: write a checkpoint once the fs has been idle for
+ * this long (0 disables), but no more often than yaffs_checkpoint_min_s.
+ * Each checkpoint programs several blocks and any later write invalidates
+ * it, so a device that is written to now and then pays for a checkpoint
+ * after every burst. That wear buys a faster mount after an unclean
+ * shutdown only, hence it is off by default.
+ */
+unsigned int yaffs_checkpoint_idle_ms;
+unsigned int yaffs_checkpoint_min_s = 300;
+
+/* Memory cap for the directory name index, per device. 0 disables it */
+unsigned int yaffs_dir_index_kb = 256;
+
 /* Module Parameters */
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
 module_param(yaffs_traceMask, uint, 0644);
 module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
+module_param(yaffs_bg_gc, uint, 0644);
+module_param(yaffs_bg_gc_idle_ms, uint, 0644);
+module_param(yaffs_bg_gc_live_pct, uint, 0644);
+module_param(yaffs_bg_gc_urgent_pct, uint, 0644);
+module_param(yaffs_dir_index_kb, uint, 0644);
+module_param(yaffs_checkpoint_idle_ms, uint, 0644);
+module_param(yaffs_checkpoint_min_s, uint, 0644);
 #else
 MODULE_PARM(yaffs_traceMask, "i");
 MODULE_PARM(yaffs_wr_attempts, "i");
@@ -172,6 +204,7 @@ static struct inode *yaffs_iget(struct super_block *sb, unsigned long ino);
 		} while(0)
 		
 static void yaffs_put_super(struct super_block *sb);
+static int yaffs_remount_fs(struct super_block *sb, int *flags, char *data);
 
 static ssize_t yaffs_file_write(struct file *f, const char *buf, size_t n,
 				loff_t *pos);
@@ -240,6 +273,10 @@ static void yaffs_delete_inode(struct inode *);
 static void yaffs_clear_inode(struct inode *);
 
 static int yaffs_readpage(struct file *file, struct page *page);
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 0))
+static int yaffs_readpages(struct file *file, struct address_space *mapping,
+			struct list_head *pages, unsigned nr_pages);
+#endif
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
 static int yaffs_writepage(struct page *page, struct writeback_control *wbc);
 #else
@@ -272,6 +309,9 @@ static int yaffs_follow_link(struct dentry *dentry, struct nameidata *nd);
 
 static struct address_space_operations yaffs_file_address_operations = {
 	.readpage = yaffs_readpage,
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 0))
+	.readpages = yaffs_readpages,
+#endif
 	.writepage = yaffs_writepage,
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 	.write_begin = yaffs_write_begin,
@@ -362,23 +402,96 @@ static const struct super_operations yaffs_super_ops = {
 	.put_inode = yaffs_put_inode,
 #endif
 	.put_super = yaffs_put_super,
+	.remount_fs = yaffs_remount_fs,
 	.delete_inode = yaffs_delete_inode,
 	.clear_inode = yaffs_clear_inode,
 	.sync_fs = yaffs_sync_fs,
 	.write_super = yaffs_write_super,
 };
 
+/*
+ * Locking.
+ *
+ * grossLock is a reader/writer semaphore. Anything that can modify the
+ * device (writes, namespace ops, GC, checkpointing) takes it exclusive and
+ * has the guts to itself, just as before. readpage takes it shared so that
+ * page reads of different files no longer queue behind each other; the only
+ * state they share underneath (mtd spare buffer, page read counters, chunk
+ * error handling) is covered by nandLock, held just around each chunk read.
+ *
+ * Every acquisition is counted, and contended ones are timed, so the cost
+ * of the remaining serialisation shows up in /proc/yaffs.
+ */
+
+static void yaffs_LockAccount(yaffs_Device *dev, yaffs_LockStats *stats,
+				int contended, ktime_t start)
+{
+	spin_lock(&dev->lockStatLock);
+	stats->acquired++;
+	if (contended) {
+		stats->contended++;
+		stats->waitUs += ktime_to_us(ktime_sub(ktime_get(), start));
+	}
+	spin_unlock(&dev->lockStatLock);
+}
+
 static void yaffs_GrossLock(yaffs_Device *dev)
 {
+	ktime_t start = ktime_set(0, 0);
+
 	T(LOCK_TRACE && YAFFS_TRACE_OS, ("yaffs locking %p\n", current));
-	down(&dev->grossLock);
+	if (down_write_trylock(&dev->grossLock)) {
+		yaffs_LockAccount(dev, &dev->grossStats, 0, start);
+	} else {
+		start = ktime_get();
+		down_write(&dev->grossLock);
+		yaffs_LockAccount(dev, &dev->grossStats, 1, start);
+	}
 	T(LOCK_TRACE && YAFFS_TRACE_OS, ("yaffs locked %p\n", current));
 }
 
 static void yaffs_GrossUnlock(yaffs_Device *dev)
 {
 	T(LOCK_TRACE && YAFFS_TRACE_OS, ("yaffs unlocking %p\n", current));
-	up(&dev->grossLock);
+	dev->lastActivity = jiffies;
+	up_write(&dev->grossLock);
+}
+
+static void yaffs_GrossLockShared(yaffs_Device *dev)
+{
+	ktime_t start = ktime_set(0, 0);
+
+	if (down_read_trylock(&dev->grossLock)) {
+		yaffs_LockAccount(dev, &dev->sharedStats, 0, start);
+	} else {
+		start = ktime_get();
+		down_read(&dev->grossLock);
+		yaffs_LockAccount(dev, &dev->sharedStats, 1, start);
+	}
+}
+
+static void yaffs_GrossUnlockShared(yaffs_Device *dev)
+{
+	dev->lastActivity = jiffies;
+	up_read(&dev->grossLock);
+}
+
+static void yaffs_NandLock(yaffs_Device *dev)
+{
+	ktime_t start = ktime_set(0, 0);
+
+	if (mutex_trylock(&dev->nandLock)) {
+		yaffs_LockAccount(dev, &dev->nandStats, 0, start);
+	} else {
+		start = ktime_get();
+		mutex_lock(&dev->nandLock);
+		yaffs_LockAccount(dev, &dev->nandStats, 1, start);
+	}
+}
+
+static void yaffs_NandUnlock(yaffs_Device *dev)
+{
+	mutex_unlock(&dev->nandLock);
 }
 
 
@@ -492,6 +605,8 @@ static void yaffs_RemoveObjectCallback(yaffs_Object *obj)
                 }
 	}
 
+	yaffs_DirIndexRemove(obj);
+
 }
 
 
@@ -575,7 +690,10 @@ static struct dentry *yaffs_lookup(struct inode *dir, struct dentry *dentry)
 		("yaffs_lookup for %d:%s\n",
 		yaffs_InodeToObject(dir)->objectId, dentry->d_name.name));
 
-	obj = yaffs_FindObjectByName(yaffs_InodeToObject(dir),
+	/* Pick up any change to the index size limit */
+	dev->dirIndexMaxBytes = yaffs_dir_index_kb * 1024;
+
+	obj = yaffs_FindObjectByNameIndexed(yaffs_InodeToObject(dir),
 					dentry->d_name.name);
 
 	obj = yaffs_GetEquivalentObject(obj);	/* in case it was a hardlink */
@@ -715,30 +833,65 @@ static int yaffs_file_flush(struct file *file)
 	return 0;
 }
 
-static int yaffs_readpage_nolock(struct file *f, struct page *pg)
-{
-	/* Lifted from jffs2 */
+/* Largest run of chunks read in one go by yaffs_ReadRunShared() */
+#define YAFFS_RUN_CHUNKS	32
 
-	yaffs_Object *obj;
-	unsigned char *pg_buf;
+/* Read a run of consecutive pages under the shared lock. The chunk
+ * locations for the whole run are looked up in one pass and then read back
+ * to back. This only works when each page is made up of whole chunks, none
+ * of which are in the short op cache; otherwise -1 is returned and the
+ * caller falls back to the exclusive path.
+ */
+static int yaffs_ReadRunShared(yaffs_Object *obj, struct page **pages,
+				int nPages)
+{
+	yaffs_Device *dev = obj->myDev;
+	int chunkSize = dev->nDataBytesPerChunk;
+	int perPage = PAGE_CACHE_SIZE / chunkSize;
+	int nChunks = nPages * perPage;
+	int nandChunk[YAFFS_RUN_CHUNKS];
+	int firstChunk;
+	__u8 *buf;
 	int ret;
+	int i;
 
-	yaffs_Device *dev;
+	if (dev->chunkDiv != 1 || (PAGE_CACHE_SIZE % chunkSize) != 0 ||
+	    nChunks > YAFFS_RUN_CHUNKS)
+		return -1;
 
-	T(YAFFS_TRACE_OS, ("yaffs_readpage_nolock at %08x, size %08x\n",
-			(unsigned)(pg->index << PAGE_CACHE_SHIFT),
-			(unsigned)PAGE_CACHE_SIZE));
+	/* Chunks within an inode are numbered from 1 */
+	firstChunk = (int)(((loff_t)pages[0]->index << PAGE_CACHE_SHIFT) >>
+				dev->chunkShift) + 1;
 
-	obj = yaffs_DentryToObject(f->f_dentry);
+	yaffs_GrossLockShared(dev);
+	yaffs_NandLock(dev);
 
-	dev = obj->myDev;
+	ret = yaffs_FindChunkRun(obj, firstChunk, nChunks, nandChunk);
 
-#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
-	BUG_ON(!PageLocked(pg));
-#else
-	if (!PageLocked(pg))
-		PAGE_BUG(pg);
-#endif
+	for (i = 0; ret >= 0 && i < nChunks; i++) {
+		buf = kmap(pages[i / perPage]);
+		buf += (i % perPage) * chunkSize;
+
+		if (nandChunk[i] >= 0)
+			yaffs_ReadChunkWithTagsFromNAND(dev, nandChunk[i], buf,
+							NULL);
+		else
+			memset(buf, 0, chunkSize);	/* a hole */
+
+		kunmap(pages[i / perPage]);
+	}
+
+	yaffs_NandUnlock(dev);
+	yaffs_GrossUnlockShared(dev);
+
+	return ret;
+}
+
+static int yaffs_ReadPageExclusive(yaffs_Object *obj, struct page *pg)
+{
+	yaffs_Device *dev = obj->myDev;
+	unsigned char *pg_buf;
+	int ret;
 
 	pg_buf = kmap(pg);
 	/* FIXME: Can kmap fail? */
@@ -751,9 +904,13 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 
 	yaffs_GrossUnlock(dev);
 
-	if (ret >= 0)
-		ret = 0;
+	kunmap(pg);
+
+	return ret >= 0 ? 0 : ret;
+}
 
+static void yaffs_FinishPageRead(struct page *pg, int ret)
+{
 	if (ret) {
 		ClearPageUptodate(pg);
 		SetPageError(pg);
@@ -763,7 +920,33 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 	}
 
 	flush_dcache_page(pg);
-	kunmap(pg);
+}
+
+static int yaffs_readpage_nolock(struct file *f, struct page *pg)
+{
+	/* Lifted from jffs2 */
+
+	yaffs_Object *obj;
+	int ret;
+
+	T(YAFFS_TRACE_OS, ("yaffs_readpage_nolock at %08x, size %08x\n",
+			(unsigned)(pg->index << PAGE_CACHE_SHIFT),
+			(unsigned)PAGE_CACHE_SIZE));
+
+	obj = yaffs_DentryToObject(f->f_dentry);
+
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
+	BUG_ON(!PageLocked(pg));
+#else
+	if (!PageLocked(pg))
+		PAGE_BUG(pg);
+#endif
+
+	ret = yaffs_ReadRunShared(obj, &pg, 1);
+	if (ret < 0)
+		ret = yaffs_ReadPageExclusive(obj, pg);
+
+	yaffs_FinishPageRead(pg, ret);
 
 	T(YAFFS_TRACE_OS, ("yaffs_readpage_nolock done\n"));
 	return ret;
@@ -786,6 +969,72 @@ static int yaffs_readpage(struct file *f, struct page *pg)
 	return ret;
 }
 
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 0))
+/* Read and complete a run of consecutive, locked pages */
+static void yaffs_readpages_run(yaffs_Object *obj, struct page **run, int n)
+{
+	int ret;
+	int i;
+
+	ret = yaffs_ReadRunShared(obj, run, n);
+
+	for (i = 0; i < n; i++) {
+		if (ret < 0)
+			yaffs_FinishPageRead(run[i],
+					yaffs_ReadPageExclusive(obj, run[i]));
+		else
+			yaffs_FinishPageRead(run[i], 0);
+		unlock_page(run[i]);
+		page_cache_release(run[i]);
+	}
+}
+
+/* Readahead. The pages are first all added to the page cache, without
+ * holding any yaffs lock, so that allocation can't recurse into
+ * yaffs_writepage. Consecutive pages are then read in runs, each with a
+ * single lock round trip, chunk lookup pass and burst of NAND reads.
+ */
+static int yaffs_readpages(struct file *f, struct address_space *mapping,
+			struct list_head *pages, unsigned nr_pages)
+{
+	yaffs_Object *obj = yaffs_DentryToObject(f->f_dentry);
+	int perPage = PAGE_CACHE_SIZE / obj->myDev->nDataBytesPerChunk;
+	int maxRun = perPage > 0 ? YAFFS_RUN_CHUNKS / perPage : 1;
+	struct page *run[YAFFS_RUN_CHUNKS];
+	struct page *pg;
+	int n = 0;
+	unsigned i;
+
+	T(YAFFS_TRACE_OS, ("yaffs_readpages %u pages\n", nr_pages));
+
+	if (maxRun < 1)
+		maxRun = 1;
+
+	for (i = 0; i < nr_pages; i++) {
+		/* The list is in reverse index order */
+		pg = list_entry(pages->prev, struct page, lru);
+		list_del(&pg->lru);
+
+		if (add_to_page_cache_lru(pg, mapping, pg->index, GFP_KERNEL)) {
+			page_cache_release(pg);
+			continue;
+		}
+
+		if (n > 0 && (n == maxRun || pg->index != run[n - 1]->index + 1)) {
+			yaffs_readpages_run(obj, run, n);
+			n = 0;
+		}
+		run[n++] = pg;
+	}
+
+	if (n > 0)
+		yaffs_readpages_run(obj, run, n);
+
+	T(YAFFS_TRACE_OS, ("yaffs_readpages done\n"));
+	return 0;
+}
+#endif
+
 /* writepage inspired by/stolen from smbfs */
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
@@ -1610,7 +1859,7 @@ static int yaffs_rename(struct inode *old_dir, struct dentry *old_dentry,
 	yaffs_GrossLock(dev);
 
 	/* Check if the target is an existing directory that is not empty. */
-	target = yaffs_FindObjectByName(yaffs_InodeToObject(new_dir),
+	target = yaffs_FindObjectByNameIndexed(yaffs_InodeToObject(new_dir),
 				new_dentry->d_name.name);
 
 
@@ -1887,17 +2136,144 @@ static void yaffs_read_inode(struct inode *inode)
 
 static YLIST_HEAD(yaffs_dev_list);
 
-#if 0 /* not used */
+/*
+ * Background garbage collection and checkpointing.
+ *
+ * Each read-write mount gets a thread that collects mostly-dirty blocks
+ * while the file system is idle, so the write path rarely has to stop and
+ * collect. The thread never waits for the gross lock: if anyone else holds
+ * it, or has used the file system in the last yaffs_bg_gc_idle_ms, it backs
+ * off. Each step copies only a few chunks, so a foreground operation that
+ * arrives mid-collection waits for at most one step.
+ *
+ * Collection invalidates the checkpoint, so the thread leaves a freshly
+ * checkpointed device alone unless it is getting short of erased blocks;
+ * otherwise an idle device would be rewriting its checkpoint forever.
+ *
+ * If yaffs_checkpoint_idle_ms is set, then once there is nothing left worth
+ * collecting and the file system has been idle that long, the thread writes
+ * a checkpoint, so that a mount after an unclean shutdown can usually skip
+ * the full scan. Otherwise checkpointing only happens on sync and unmount. The thread only
+ * checkpoints the device state: walking the superblock's inode list is not
+ * safe without the VFS locks, so dirty inodes are left to the next sync.
+ */
+
+static int yaffs_BackgroundGcLimit(yaffs_Device *dev)
+{
+	unsigned pct = yaffs_bg_gc_live_pct;
+	int urgent = dev->nErasedBlocks < dev->nReservedBlocks * 3;
+
+	if (dev->isCheckpointed && !urgent)
+		return -1;
+
+	if (urgent)
+		pct = yaffs_bg_gc_urgent_pct;
+	if (pct > 100)
+		pct = 100;
+
+	return (dev->nChunksPerBlock * pct) / 100;
+}
+
+/* Should the background thread write a checkpoint now? */
+static int yaffs_BackgroundCheckpointDue(yaffs_Device *dev)
+{
+	if (!yaffs_checkpoint_idle_ms || dev->isCheckpointed)
+		return 0;
+
+	if (time_before(jiffies, dev->lastActivity +
+			msecs_to_jiffies(yaffs_checkpoint_idle_ms)))
+		return 0;
+
+	return dev->nRuntimeCheckpoints == 0 ||
+		time_after_eq(jiffies, dev->lastCheckpoint +
+				yaffs_checkpoint_min_s * HZ);
+}
+
+static int yaffs_BackgroundThread(void *data)
+{
+	yaffs_Device *dev = (yaffs_Device *)data;
+	unsigned long idle;
+	int maxLive;
+	int worked;
+
+	T(YAFFS_TRACE_GC, ("yaffs_background starting for %s\n", dev->name));
+
+	while (!kthread_should_stop()) {
+		idle = msecs_to_jiffies(yaffs_bg_gc_idle_ms);
+		worked = 0;
+
+		if (yaffs_bg_gc &&
+		    time_after_eq(jiffies, dev->lastActivity + idle) &&
+		    down_write_trylock(&dev->grossLock)) {
+			maxLive = yaffs_BackgroundGcLimit(dev);
+			if (maxLive >= 0)
+				worked = yaffs_BackgroundGarbageCollect(dev, maxLive);
+			up_write(&dev->grossLock);
+		}
+
+		if (!worked && yaffs_BackgroundCheckpointDue(dev) &&
+		    down_write_trylock(&dev->grossLock)) {
+			T(YAFFS_TRACE_CHECKPOINT,
+			  ("yaffs_background: checkpointing %s\n", dev->name));
+			yaffs_FlushEntireDeviceCache(dev);
+			yaffs_CheckpointSave(dev);
+			dev->lastCheckpoint = jiffies;
+			dev->nRuntimeCheckpoints++;
+			up_write(&dev->grossLock);
+		}
+
+		if (worked)
+			cond_resched();
+		else
+			schedule_timeout_interruptible(idle ? idle : 1);
+	}
+
+	T(YAFFS_TRACE_GC, ("yaffs_background stopping for %s\n", dev->name));
+	return 0;
+}
+
+static void yaffs_BackgroundStart(struct super_block *sb, yaffs_Device *dev)
+{
+	struct task_struct *tsk;
+
+	dev->lastActivity = jiffies;
+	tsk = kthread_run(yaffs_BackgroundThread, dev, "yaffs-bg-%s",
+			  sb->s_id);
+	if (IS_ERR(tsk)) {
+		T(YAFFS_TRACE_ALWAYS,
+		  ("yaffs: could not start background gc for %s\n", dev->name));
+		return;
+	}
+	dev->bgThread = tsk;
+}
+
+static void yaffs_BackgroundStop(yaffs_Device *dev)
+{
+	if (dev->bgThread) {
+		kthread_stop(dev->bgThread);
+		dev->bgThread = NULL;
+	}
+}
+
+/*
+ * The background thread only runs on read-write mounts, so it is stopped
+ * and started as the mount changes between read-only and read-write.
+ * Like mount and put_super, this runs with s_umount held and outside the
+ * gross lock, which the thread itself takes.
+ */
 static int yaffs_remount_fs(struct super_block *sb, int *flags, char *data)
 {
 	yaffs_Device    *dev = yaffs_SuperToDevice(sb);
+	int was_ro = (sb->s_flags & MS_RDONLY) != 0;
 
-	if (*flags & MS_RDONLY) {
+	if ((*flags & MS_RDONLY) && !was_ro) {
 		struct mtd_info *mtd = yaffs_SuperToDevice(sb)->genericDevice;
 
 		T(YAFFS_TRACE_OS,
 			("yaffs_remount_fs: %s: RO\n", dev->name));
 
+		yaffs_BackgroundStop(dev);
+
 		yaffs_GrossLock(dev);
 
 		yaffs_FlushEntireDeviceCache(dev);
@@ -1908,14 +2284,15 @@ static int yaffs_remount_fs(struct super_block *sb, int *flags, char *data)
 			mtd->sync(mtd);
 
 		yaffs_GrossUnlock(dev);
-	} else {
+	} else if (!(*flags & MS_RDONLY) && was_ro) {
 		T(YAFFS_TRACE_OS,
 			("yaffs_remount_fs: %s: RW\n", dev->name));
+
+		yaffs_BackgroundStart(sb, dev);
 	}
 
 	return 0;
 }
-#endif
 
 static void yaffs_put_super(struct super_block *sb)
 {
@@ -1923,6 +2300,8 @@ static void yaffs_put_super(struct super_block *sb)
 
 	T(YAFFS_TRACE_OS, ("yaffs_put_super\n"));
 
+	yaffs_BackgroundStop(dev);
+
 	yaffs_GrossLock(dev);
 
 	yaffs_FlushEntireDeviceCache(dev);
@@ -1932,6 +2311,9 @@ static void yaffs_put_super(struct super_block *sb)
 	if (dev->putSuperFunc)
 		dev->putSuperFunc(sb);
 
+	yaffs_DirIndexFreeAll(dev);
+	yaffs_ChunkCacheIndexFree(dev);
+
 	yaffs_Deinitialise(dev);
 
 	yaffs_GrossUnlock(dev);
@@ -1973,6 +2355,7 @@ typedef struct {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int n_caches;
 	int tags_ecc_on;
 	int tags_ecc_overridden;
 	int lazy_loading_enabled;
@@ -2027,6 +2410,16 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options->empty_lost_and_found_overridden=1;
 		} else if (!strcmp(cur_opt, "no-cache"))
 			options->no_cache = 1;
+		else if (!strncmp(cur_opt, "cache=", 6)) {
+			options->n_caches = simple_strtoul(cur_opt + 6, NULL, 0);
+			if (options->n_caches < 1 ||
+			    options->n_caches > YAFFS_MAX_SHORT_OP_CACHES) {
+				printk(KERN_INFO
+					"yaffs: cache size must be 1..%d chunks\n",
+					YAFFS_MAX_SHORT_OP_CACHES);
+				error = 1;
+			}
+		}
 		else if (!strcmp(cur_opt, "no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-write"))
@@ -2056,6 +2449,7 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	struct mtd_info *mtd;
 	int err;
 	char *data_str = (char *)data;
+	ktime_t mountStart;
 
 	yaffs_options options;
 
@@ -2238,7 +2632,12 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	dev->nChunksPerBlock = YAFFS_CHUNKS_PER_BLOCK;
 	dev->totalBytesPerChunk = YAFFS_BYTES_PER_CHUNK;
 	dev->nReservedBlocks = 5;
-	dev->nShortOpCaches = (options.no_cache) ? 0 : 10;
+	if (options.no_cache)
+		dev->nShortOpCaches = 0;
+	else if (options.n_caches)
+		dev->nShortOpCaches = options.n_caches;
+	else
+		dev->nShortOpCaches = 10;
 	dev->inbandTags = options.inband_tags;
 
 #ifdef CONFIG_YAFFS_DISABLE_LAZY_LOAD
@@ -2323,15 +2722,38 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
         YINIT_LIST_HEAD(&dev->searchContexts);
         dev->removeObjectCallback = yaffs_RemoveObjectCallback;
 
-	init_MUTEX(&dev->grossLock);
+	/* Directory name index */
+	YINIT_LIST_HEAD(&dev->dirIndexList);
+	dev->dirIndexMaxBytes = yaffs_dir_index_kb * 1024;
+
+	init_rwsem(&dev->grossLock);
+	mutex_init(&dev->nandLock);
+	spin_lock_init(&dev->lockStatLock);
+
+	/* Let the scan read a whole block's tags at a time */
+	dev->scanOobBlock = -1;
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
+	if (dev->isYaffs2 && !dev->inbandTags)
+		dev->scanOobBuffer = YMALLOC(mtd->oobavail * dev->nChunksPerBlock);
+#endif
 
 	yaffs_GrossLock(dev);
 
+	mountStart = ktime_get();
 	err = yaffs_GutsInitialise(dev);
+	dev->mountTimeUs = ktime_to_us(ktime_sub(ktime_get(), mountStart));
+
+	if (dev->scanOobBuffer) {
+		YFREE(dev->scanOobBuffer);
+		dev->scanOobBuffer = NULL;
+	}
 
 	T(YAFFS_TRACE_OS,
 	  ("yaffs_read_super: guts initialised %s\n",
 	   (err == YAFFS_OK) ? "OK" : "FAILED"));
+	T(YAFFS_TRACE_OS,
+	  ("yaffs_read_super: mount took %llu us, %u batched tag reads\n",
+	   (unsigned long long)dev->mountTimeUs, dev->nBatchedTagReads));
 
 	/* Release lock before yaffs_get_inode() */
 	yaffs_GrossUnlock(dev);
@@ -2362,6 +2784,9 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	T(YAFFS_TRACE_ALWAYS,
 	  ("yaffs_read_super: isCheckpointed %d\n", dev->isCheckpointed));
 
+	if (!(sb->s_flags & MS_RDONLY))
+		yaffs_BackgroundStart(sb, dev);
+
 	T(YAFFS_TRACE_OS, ("yaffs_read_super: done\n"));
 	return sb;
 }
@@ -2486,6 +2911,12 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "garbageCollections. %d\n", dev->garbageCollections);
 	buf += sprintf(buf, "passiveGCs......... %d\n",
 		    dev->passiveGarbageCollections);
+	buf += sprintf(buf, "backgroundGCs...... %d\n",
+		    dev->backgroundGarbageCollections);
+	buf += sprintf(buf, "gcTimeForeground... %llu us\n",
+		    (unsigned long long)dev->gcTimeForeground);
+	buf += sprintf(buf, "gcTimeBackground... %llu us\n",
+		    (unsigned long long)dev->gcTimeBackground);
 	buf += sprintf(buf, "nRetriedWrites..... %d\n", dev->nRetriedWrites);
 	buf += sprintf(buf, "nShortOpCaches..... %d\n", dev->nShortOpCaches);
 	buf += sprintf(buf, "nRetireBlocks...... %d\n", dev->nRetiredBlocks);
@@ -2494,6 +2925,9 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "tagsEccFixed....... %d\n", dev->tagsEccFixed);
 	buf += sprintf(buf, "tagsEccUnfixed..... %d\n", dev->tagsEccUnfixed);
 	buf += sprintf(buf, "cacheHits.......... %d\n", dev->cacheHits);
+	buf += sprintf(buf, "cacheMisses........ %d\n", dev->cacheMisses);
+	buf += sprintf(buf, "cacheEvictions..... %d\n", dev->cacheEvictions);
+	buf += sprintf(buf, "cacheWriteBacks.... %d\n", dev->cacheWriteBacks);
 	buf += sprintf(buf, "nDeletedFiles...... %d\n", dev->nDeletedFiles);
 	buf += sprintf(buf, "nUnlinkedFiles..... %d\n", dev->nUnlinkedFiles);
 	buf +=
@@ -2503,6 +2937,14 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_Device * dev)
 }
 
 
+static char *yaffs_dump_lock_stats(char *buf, const char *name,
+					yaffs_LockStats *stats)
+{
+	return buf + sprintf(buf, "%s %u taken, %u contended, %llu us waiting\n",
+			name, stats->acquired, stats->contended,
+			(unsigned long long)stats->waitUs);
+}
+
 static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 {
 	buf += sprintf(buf, "useNANDECC......... %d\n", dev->useNANDECC);
@@ -2511,6 +2953,22 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "inbandTags......... %d\n", dev->inbandTags);
 	buf += sprintf(buf, "emptyLostAndFound.. %d\n", dev->emptyLostAndFound);
 	buf += sprintf(buf, "disableLazyLoad.... %d\n", dev->disableLazyLoad);
+	buf += sprintf(buf, "mountTime.......... %llu us\n",
+		    (unsigned long long)dev->mountTimeUs);
+	buf += sprintf(buf, "batchedTagReads.... %u\n", dev->nBatchedTagReads);
+	buf += sprintf(buf, "runtimeCheckpoints. %u\n", dev->nRuntimeCheckpoints);
+	buf += sprintf(buf, "dirIndexBytes...... %d\n", dev->dirIndexBytes);
+	buf += sprintf(buf, "dirIndexBuilds..... %d\n", dev->nDirIndexBuilds);
+	buf += sprintf(buf, "dirIndexEvictions.. %d\n", dev->nDirIndexEvictions);
+	buf += sprintf(buf, "nameLookups........ %d\n", dev->nNameLookups);
+	buf += sprintf(buf, "nameLookupAvg...... %llu us\n",
+		    dev->nNameLookups ? (unsigned long long)
+		    div_u64(dev->nameLookupTimeUs, dev->nNameLookups) : 0ULL);
+	buf += sprintf(buf, "nameLookupMax...... %u us\n",
+		    dev->nameLookupMaxUs);
+	buf = yaffs_dump_lock_stats(buf, "grossLock..........", &dev->grossStats);
+	buf = yaffs_dump_lock_stats(buf, "grossLock (shared).", &dev->sharedStats);
+	buf = yaffs_dump_lock_stats(buf, "nandLock...........", &dev->nandStats);
 
 	return buf;
 }
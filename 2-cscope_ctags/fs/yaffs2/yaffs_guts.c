@@ -35,6 +35,10 @@ const char *yaffs_guts_c_version =
 
 #define YAFFS_PASSIVE_GC_CHUNKS 2
 
+#ifndef Y_CLOCK_US
+#define Y_CLOCK_US() 0
+#endif
+
 #include "yaffs_ecc.h"
 
 
@@ -69,6 +73,8 @@ static void yaffs_AddObjectToDirectory(yaffs_Object *directory,
 static int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name,
 				int force, int isShrink, int shadows);
 static void yaffs_RemoveObjectFromDirectory(yaffs_Object *obj);
+static void yaffs_DirIndexInsert(yaffs_Object *dir, yaffs_Object *obj);
+static void yaffs_DirIndexFree(yaffs_Object *dir);
 static int yaffs_CheckStructures(void);
 static int yaffs_DeleteWorker(yaffs_Object *in, yaffs_Tnode *tn, __u32 level,
 			int chunkOffset, int *limit);
@@ -101,6 +107,8 @@ static int yaffs_CheckFileSanity(yaffs_Object *in);
 
 static void yaffs_InvalidateWholeChunkCache(yaffs_Object *in);
 static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId);
+static yaffs_ChunkCache *yaffs_LookupChunkCache(const yaffs_Object *obj,
+						int chunkId);
 
 static void yaffs_InvalidateCheckpoint(yaffs_Device *dev);
 
@@ -1177,6 +1185,241 @@ static void yaffs_SetObjectName(yaffs_Object *obj, const YCHAR *name)
 	obj->sum = yaffs_CalcNameSum(name);
 }
 
+/*---------------- Directory name index ------------
+ *
+ * yaffs_FindObjectByName() walks the whole children list, which gets slow
+ * for directories with thousands of entries. Large directories get a hash
+ * index, keyed on the name sum, built the first time they are searched.
+ * Each child is chained into its bucket through obj->dirHashLink. The index
+ * is kept up to date as objects are added (yaffs_DirIndexInsert()) and
+ * removed (yaffs_DirIndexRemove()); if it outgrows its buckets it is just
+ * dropped and rebuilt larger on the next lookup.
+ *
+ * All indexes on a device share a memory cap, dev->dirIndexMaxBytes. When
+ * a new index would go over it, the least recently used ones are freed.
+ *
+ * lost+found (whose children may be headerless objNNN entries with no
+ * valid name sum) and the unlinked/deleted directories are never indexed,
+ * and looking up "lost+found" itself always uses the plain search.
+ */
+
+/* Directories with fewer children than this are searched directly */
+#define YAFFS_DIR_INDEX_MIN_CHILDREN	32
+
+/* Buckets per index are sized for about this many entries each */
+#define YAFFS_DIR_INDEX_LOAD		2
+
+static void yaffs_DirIndexFree(yaffs_Object *dir)
+{
+	yaffs_DirIndex *idx = dir->variant.directoryVariant.index;
+	yaffs_Device *dev = dir->myDev;
+	struct ylist_head *i;
+	struct ylist_head *n;
+	int b;
+
+	if (!idx)
+		return;
+
+	for (b = 0; b < idx->nBuckets; b++)
+		ylist_for_each_safe(i, n, &idx->buckets[b])
+			ylist_del_init(i);
+
+	ylist_del(&idx->indexList);
+	dev->dirIndexBytes -= idx->bytes;
+
+	if (idx->bucketsAlt)
+		YFREE_ALT(idx->buckets);
+	else
+		YFREE(idx->buckets);
+	YFREE(idx);
+
+	dir->variant.directoryVariant.index = NULL;
+}
+
+void yaffs_DirIndexFreeAll(yaffs_Device *dev)
+{
+	yaffs_DirIndex *idx;
+
+	while (!ylist_empty(&dev->dirIndexList)) {
+		idx = ylist_entry(dev->dirIndexList.next, yaffs_DirIndex,
+				indexList);
+		yaffs_DirIndexFree(idx->dir);
+	}
+}
+
+static void yaffs_DirIndexInsert(yaffs_Object *dir, yaffs_Object *obj)
+{
+	yaffs_DirIndex *idx = dir->variant.directoryVariant.index;
+
+	if (!idx || obj->objectId == YAFFS_OBJECTID_LOSTNFOUND)
+		return;
+
+	ylist_del_init(&obj->dirHashLink);
+	ylist_add(&obj->dirHashLink,
+		&idx->buckets[obj->sum & (idx->nBuckets - 1)]);
+	idx->nEntries++;
+
+	if (idx->nEntries > idx->nBuckets * YAFFS_DIR_INDEX_LOAD * 4)
+		yaffs_DirIndexFree(dir);
+}
+
+/* Must be called whenever an object is removed from its directory, before
+ * obj->parent is cleared. Also drops the object's own index if it is a
+ * directory, since it is either being deleted or moved.
+ */
+void yaffs_DirIndexRemove(yaffs_Object *obj)
+{
+	yaffs_Object *parent = obj->parent;
+
+	if (!ylist_empty(&obj->dirHashLink)) {
+		ylist_del_init(&obj->dirHashLink);
+		if (parent && parent->variant.directoryVariant.index)
+			parent->variant.directoryVariant.index->nEntries--;
+	}
+
+	if (obj->variantType == YAFFS_OBJECT_TYPE_DIRECTORY)
+		yaffs_DirIndexFree(obj);
+}
+
+static yaffs_DirIndex *yaffs_DirIndexBuild(yaffs_Object *dir)
+{
+	yaffs_Device *dev = dir->myDev;
+	yaffs_DirIndex *idx;
+	yaffs_DirIndex *victim;
+	yaffs_Object *l;
+	struct ylist_head *i;
+	int nChildren = 0;
+	int nBuckets;
+	int bytes;
+	int b;
+
+	if (dir == dev->lostNFoundDir ||
+	    dir == dev->unlinkedDir || dir == dev->deletedDir)
+		return NULL;
+
+	ylist_for_each(i, &dir->variant.directoryVariant.children)
+		nChildren++;
+
+	if (nChildren < YAFFS_DIR_INDEX_MIN_CHILDREN)
+		return NULL;
+
+	nBuckets = 16;
+	while (nBuckets * YAFFS_DIR_INDEX_LOAD < nChildren && nBuckets < 65536)
+		nBuckets <<= 1;
+
+	bytes = sizeof(yaffs_DirIndex) + nBuckets * sizeof(struct ylist_head);
+	if (bytes > dev->dirIndexMaxBytes)
+		return NULL;
+
+	/* Make room by dropping the least recently used indexes */
+	while (dev->dirIndexBytes + bytes > dev->dirIndexMaxBytes &&
+	       !ylist_empty(&dev->dirIndexList)) {
+		victim = ylist_entry(dev->dirIndexList.prev, yaffs_DirIndex,
+				indexList);
+		yaffs_DirIndexFree(victim->dir);
+		dev->nDirIndexEvictions++;
+	}
+
+	idx = YMALLOC(sizeof(yaffs_DirIndex));
+	if (!idx)
+		return NULL;
+
+	memset(idx, 0, sizeof(yaffs_DirIndex));
+	idx->buckets = YMALLOC(nBuckets * sizeof(struct ylist_head));
+	if (!idx->buckets) {
+		idx->buckets = YMALLOC_ALT(nBuckets * sizeof(struct ylist_head));
+		idx->bucketsAlt = 1;
+	}
+	if (!idx->buckets) {
+		YFREE(idx);
+		return NULL;
+	}
+
+	idx->dir = dir;
+	idx->nBuckets = nBuckets;
+	idx->bytes = bytes;
+	for (b = 0; b < nBuckets; b++)
+		YINIT_LIST_HEAD(&idx->buckets[b]);
+
+	dir->variant.directoryVariant.index = idx;
+	ylist_add(&idx->indexList, &dev->dirIndexList);
+	dev->dirIndexBytes += bytes;
+	dev->nDirIndexBuilds++;
+
+	ylist_for_each(i, &dir->variant.directoryVariant.children) {
+		l = ylist_entry(i, yaffs_Object, siblings);
+		yaffs_CheckObjectDetailsLoaded(l);
+		yaffs_DirIndexInsert(dir, l);
+	}
+
+	/* Can't have outgrown itself while being built */
+	return dir->variant.directoryVariant.index;
+}
+
+/* Same result as yaffs_FindObjectByName(), through the name index when the
+ * directory is big enough to have one.
+ */
+yaffs_Object *yaffs_FindObjectByNameIndexed(yaffs_Object *directory,
+					const YCHAR *name)
+{
+	yaffs_Device *dev;
+	yaffs_DirIndex *idx;
+	yaffs_Object *l;
+	yaffs_Object *found = NULL;
+	struct ylist_head *i;
+	YCHAR buffer[YAFFS_MAX_NAME_LENGTH + 1];
+	__u64 start;
+	__u32 took;
+	int sum;
+
+	if (!name || !directory ||
+	    directory->variantType != YAFFS_OBJECT_TYPE_DIRECTORY)
+		return yaffs_FindObjectByName(directory, name);
+
+	dev = directory->myDev;
+	start = Y_CLOCK_US();
+
+	if (dev->dirIndexMaxBytes <= 0 && dev->dirIndexBytes > 0)
+		yaffs_DirIndexFreeAll(dev);
+
+	idx = directory->variant.directoryVariant.index;
+	if (!idx && dev->dirIndexMaxBytes > 0)
+		idx = yaffs_DirIndexBuild(directory);
+
+	if (!idx || yaffs_strcmp(name, YAFFS_LOSTNFOUND_NAME) == 0) {
+		found = yaffs_FindObjectByName(directory, name);
+	} else {
+		/* Keep the LRU order */
+		ylist_del(&idx->indexList);
+		ylist_add(&idx->indexList, &dev->dirIndexList);
+
+		sum = yaffs_CalcNameSum(name);
+
+		ylist_for_each(i, &idx->buckets[sum & (idx->nBuckets - 1)]) {
+			l = ylist_entry(i, yaffs_Object, dirHashLink);
+			if (l->parent != directory)
+				YBUG();
+			if (yaffs_SumCompare(l->sum, sum) || l->hdrChunk <= 0) {
+				yaffs_GetObjectName(l, buffer,
+						YAFFS_MAX_NAME_LENGTH);
+				if (yaffs_strncmp(name, buffer,
+						YAFFS_MAX_NAME_LENGTH) == 0) {
+					found = l;
+					break;
+				}
+			}
+		}
+	}
+
+	took = (__u32)(Y_CLOCK_US() - start);
+	dev->nNameLookups++;
+	dev->nameLookupTimeUs += took;
+	if (took > dev->nameLookupMaxUs)
+		dev->nameLookupMaxUs = took;
+
+	return found;
+}
+
 /*-------------------- TNODES -------------------
 
  * List of spare tnodes
@@ -1983,6 +2226,7 @@ static yaffs_Object *yaffs_AllocateEmptyObject(yaffs_Device *dev)
 		YINIT_LIST_HEAD(&(tn->hardLinks));
 		YINIT_LIST_HEAD(&(tn->hashLink));
 		YINIT_LIST_HEAD(&tn->siblings);
+		YINIT_LIST_HEAD(&tn->dirHashLink);
 
 
 		/* Now make the directory sane */
@@ -2054,6 +2298,10 @@ static void yaffs_FreeObject(yaffs_Object *tn)
 	if (!ylist_empty(&tn->siblings))
 		YBUG();
 
+	ylist_del_init(&tn->dirHashLink);
+	if (tn->variantType == YAFFS_OBJECT_TYPE_DIRECTORY)
+		yaffs_DirIndexFree(tn);
+
 
 #ifdef __KERNEL__
 	if (tn->myInode) {
@@ -2348,7 +2596,7 @@ static yaffs_Object *yaffs_MknodObject(yaffs_ObjectType type,
 	yaffs_Device *dev = parent->myDev;
 
 	/* Check if the entry exists. If it does then fail the call since we don't want a dup.*/
-	if (yaffs_FindObjectByName(parent, name))
+	if (yaffs_FindObjectByNameIndexed(parent, name))
 		return NULL;
 
 	if (type == YAFFS_OBJECT_TYPE_SYMLINK) {
@@ -2393,6 +2641,7 @@ static yaffs_Object *yaffs_MknodObject(yaffs_ObjectType type,
 		in->dirty = 1;
 
 		yaffs_AddObjectToDirectory(parent, in);
+		yaffs_DirIndexInsert(parent, in);
 
 		in->myDev = parent->myDev;
 
@@ -2501,7 +2750,7 @@ static int yaffs_ChangeObjectName(yaffs_Object *obj, yaffs_Object *newDir,
 
 	deleteOp = (newDir == obj->myDev->deletedDir);
 
-	existingTarget = yaffs_FindObjectByName(newDir, newName);
+	existingTarget = yaffs_FindObjectByNameIndexed(newDir, newName);
 
 	/* If the object is a file going into the unlinked directory,
 	 *   then it is OK to just stuff it in since duplicate names are allowed.
@@ -2518,6 +2767,7 @@ static int yaffs_ChangeObjectName(yaffs_Object *obj, yaffs_Object *newDir,
 		obj->dirty = 1;
 
 		yaffs_AddObjectToDirectory(newDir, obj);
+		yaffs_DirIndexInsert(newDir, obj);
 
 		if (unlinkOp)
 			obj->unlinked = 1;
@@ -2560,13 +2810,13 @@ int yaffs_RenameObject(yaffs_Object *oldDir, const YCHAR *oldName,
 		/* ENAMETOOLONG */
 		return YAFFS_FAIL;
 
-	obj = yaffs_FindObjectByName(oldDir, oldName);
+	obj = yaffs_FindObjectByNameIndexed(oldDir, oldName);
 
 	if (obj && obj->renameAllowed) {
 
 		/* Now do the handling for an existing target, if there is one */
 
-		existingTarget = yaffs_FindObjectByName(newDir, newName);
+		existingTarget = yaffs_FindObjectByNameIndexed(newDir, newName);
 		if (existingTarget &&
 			existingTarget->variantType == YAFFS_OBJECT_TYPE_DIRECTORY &&
 			!ylist_empty(&existingTarget->variant.directoryVariant.children)) {
@@ -3317,12 +3567,16 @@ static int yaffs_CheckGarbageCollection(yaffs_Device *dev)
 	int maxTries = 0;
 
 	int checkpointBlockAdjust;
+	int collected = 0;
+	__u64 start;
 
 	if (dev->isDoingGC) {
 		/* Bail out so we don't get recursive gc */
 		return YAFFS_OK;
 	}
 
+	start = Y_CLOCK_US();
+
 	/* This loop should pass the first time.
 	 * We'll only see looping here if the erase of the collected block fails.
 	 */
@@ -3360,6 +3614,7 @@ static int yaffs_CheckGarbageCollection(yaffs_Device *dev)
 			   dev->nErasedBlocks, aggressive));
 
 			gcOk = yaffs_GarbageCollectBlock(dev, block, aggressive);
+			collected = 1;
 		}
 
 		if (dev->nErasedBlocks < (dev->nReservedBlocks) && block > 0) {
@@ -3372,9 +3627,91 @@ static int yaffs_CheckGarbageCollection(yaffs_Device *dev)
 		 (block > 0) &&
 		 (maxTries < 2));
 
+	if (collected)
+		dev->gcTimeForeground += Y_CLOCK_US() - start;
+
 	return aggressive ? gcOk : YAFFS_OK;
 }
 
+/* Background gc only looks for full blocks that are mostly garbage. Unlike
+ * yaffs_FindBlockForGarbageCollection() it always searches the whole device:
+ * it runs when the device is idle, so there is time to find the best block.
+ */
+static int yaffs_FindBlockForBackgroundGC(yaffs_Device *dev, int maxLive)
+{
+	int b = dev->currentDirtyChecker;
+	int i;
+	int dirtiest = -1;
+	int pagesInUse = maxLive + 1;
+	int nBlocks = dev->internalEndBlock - dev->internalStartBlock + 1;
+	yaffs_BlockInfo *bi;
+
+	for (i = 0; i < nBlocks && pagesInUse > 0; i++) {
+		b++;
+		if (b < dev->internalStartBlock || b > dev->internalEndBlock)
+			b = dev->internalStartBlock;
+
+		bi = yaffs_GetBlockInfo(dev, b);
+
+		if (bi->blockState == YAFFS_BLOCK_STATE_FULL &&
+			(bi->pagesInUse - bi->softDeletions) < pagesInUse &&
+				yaffs_BlockNotDisqualifiedFromGC(dev, bi)) {
+			dirtiest = b;
+			pagesInUse = (bi->pagesInUse - bi->softDeletions);
+		}
+	}
+
+	dev->currentDirtyChecker = b;
+	dev->oldestDirtySequence = 0;
+
+	if (dirtiest > 0) {
+		T(YAFFS_TRACE_GC,
+		  (TSTR("Background GC selected block %d with %d free" TENDSTR),
+		   dirtiest, dev->nChunksPerBlock - pagesInUse));
+	}
+
+	return dirtiest;
+}
+
+/* Do one step of background garbage collection.
+ * This is meant to be called by the OS layer while the device is idle, so
+ * that the write path rarely has to collect. A step copies at most a few
+ * chunks (the same as a passive gc pass from the write path) so the caller
+ * only holds the device for a short time. A block that the write path has
+ * already started collecting is carried on with.
+ * Returns 1 if some work was done, 0 if nothing has at most maxLive chunks
+ * in use.
+ */
+int yaffs_BackgroundGarbageCollect(yaffs_Device *dev, int maxLive)
+{
+	int block;
+	__u64 start;
+
+	if (dev->isDoingGC || !dev->isMounted)
+		return 0;
+
+	start = Y_CLOCK_US();
+
+	if (dev->gcBlock <= 0) {
+		dev->gcBlock = yaffs_FindBlockForBackgroundGC(dev, maxLive);
+		dev->gcChunk = 0;
+	}
+
+	block = dev->gcBlock;
+	if (block <= 0)
+		return 0;
+
+	dev->garbageCollections++;
+	dev->passiveGarbageCollections++;
+	dev->backgroundGarbageCollections++;
+
+	yaffs_GarbageCollectBlock(dev, block, 0);
+
+	dev->gcTimeBackground += Y_CLOCK_US() - start;
+
+	return 1;
+}
+
 /*-------------------------  TAGS --------------------------------*/
 
 static int yaffs_TagsMatch(const yaffs_ExtendedTags *tags, int objectId,
@@ -3657,6 +3994,55 @@ static int yaffs_ReadChunkDataFromObject(yaffs_Object *in, int chunkInInode,
 
 }
 
+/* Find where a run of nChunks file chunks starting at firstChunk lives in
+ * NAND, so that the caller can read them back to back. nandChunk[i] is set
+ * to the NAND chunk holding chunk firstChunk + i, or -1 for a hole.
+ * The level 0 tnode is only looked up once per YAFFS_NTNODES_LEVEL0 chunks.
+ *
+ * This is for callers that do not own the device exclusively: only the
+ * tnode tree is walked (plus NAND tag reads if chunk groups are in use), so
+ * several readers may run this at once as long as nothing is modifying the
+ * device and NAND access is serialised.
+ * Returns -1 if any of the chunks is held in the short op cache (or inband
+ * tags are in use) and the caller must go through yaffs_ReadDataFromFile()
+ * instead.
+ */
+int yaffs_FindChunkRun(yaffs_Object *in, int firstChunk, int nChunks,
+			int *nandChunk)
+{
+	yaffs_Device *dev = in->myDev;
+	yaffs_Tnode *tn = NULL;
+	yaffs_ExtendedTags tags;
+	int chunkInInode;
+	int theChunk;
+	int i;
+
+	if (dev->inbandTags)
+		return -1;
+
+	for (i = 0; i < nChunks; i++) {
+		if (yaffs_LookupChunkCache(in, firstChunk + i))
+			return -1;
+	}
+
+	for (i = 0; i < nChunks; i++) {
+		chunkInInode = firstChunk + i;
+
+		if (i == 0 || (chunkInInode & YAFFS_TNODES_LEVEL0_MASK) == 0)
+			tn = yaffs_FindLevel0Tnode(dev, &in->variant.fileVariant,
+						chunkInInode);
+
+		nandChunk[i] = -1;
+		if (tn) {
+			theChunk = yaffs_GetChunkGroupBase(dev, tn, chunkInInode);
+			nandChunk[i] = yaffs_FindChunkInGroup(dev, theChunk, &tags,
+						in->objectId, chunkInInode);
+		}
+	}
+
+	return 0;
+}
+
 void yaffs_DeleteChunk(yaffs_Device *dev, int chunkId, int markNAND, int lyn)
 {
 	int block;
@@ -3961,10 +4347,131 @@ int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   The cache used to be small (~10 chunks) and searched linearly. It can now be
+ *   made much larger, so lookups go through a hash on (objectId, chunkId) and
+ *   victims come off an LRU list. Both are built the first time the cache is
+ *   used. If the index can't be allocated we fall back to the linear search.
+ *
+ *   Entries only change identity by being handed out by yaffs_GrabChunkCache(),
+ *   so the grabbed entry is remembered in srCachePending and hashed at the start
+ *   of the next cache operation. Entries that are invalidated in place just have
+ *   their object cleared; they stay on their hash chain and never match.
  */
 
+static int yaffs_ChunkCacheHash(yaffs_Device *dev, const yaffs_Object *obj,
+				int chunkId)
+{
+	return ((obj->objectId << 5) ^ chunkId) & (dev->srCacheHashSize - 1);
+}
+
+/* Hash the entry handed out by the last grab, now that it has been filled in */
+static void yaffs_ChunkCacheSettle(yaffs_Device *dev)
+{
+	yaffs_ChunkCache *cache = dev->srCachePending;
+
+	if (!cache || !cache->object)
+		return;
+
+	dev->srCachePending = NULL;
+	ylist_del_init(&cache->hashLink);
+	ylist_add(&cache->hashLink,
+		  &dev->srCacheHash[yaffs_ChunkCacheHash(dev, cache->object,
+							  cache->chunkId)]);
+	ylist_del(&cache->lruLink);
+	ylist_add(&cache->lruLink, &dev->srCacheLru);
+}
+
+/* Returns 1 if the cache index can be used */
+static int yaffs_ChunkCacheIndexReady(yaffs_Device *dev)
+{
+	yaffs_ChunkCache *cache;
+	int size;
+	int i;
+
+	if (dev->nShortOpCaches <= 0)
+		return 0;
+
+	if (!dev->srCacheHash) {
+		size = 16;
+		while (size < dev->nShortOpCaches)
+			size <<= 1;
+
+		dev->srCacheHash = YMALLOC(size * sizeof(struct ylist_head));
+		if (!dev->srCacheHash)
+			return 0;
+
+		dev->srCacheHashSize = size;
+		for (i = 0; i < size; i++)
+			YINIT_LIST_HEAD(&dev->srCacheHash[i]);
+
+		YINIT_LIST_HEAD(&dev->srCacheLru);
+		for (i = 0; i < dev->nShortOpCaches; i++) {
+			cache = &dev->srCache[i];
+			YINIT_LIST_HEAD(&cache->hashLink);
+			if (cache->object)
+				ylist_add(&cache->hashLink,
+					  &dev->srCacheHash[yaffs_ChunkCacheHash(dev,
+							cache->object, cache->chunkId)]);
+			ylist_add_tail(&cache->lruLink, &dev->srCacheLru);
+		}
+		dev->srCachePending = NULL;
+	}
+
+	yaffs_ChunkCacheSettle(dev);
+
+	return 1;
+}
+
+/* Take a freed entry off its hash chain and make it the first to be reused */
+static void yaffs_ChunkCacheRelease(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	cache->object = NULL;
+	if (dev->srCacheHash) {
+		ylist_del_init(&cache->hashLink);
+		ylist_del(&cache->lruLink);
+		ylist_add_tail(&cache->lruLink, &dev->srCacheLru);
+	}
+}
+
+void yaffs_ChunkCacheIndexFree(yaffs_Device *dev)
+{
+	if (dev->srCacheHash) {
+		YFREE(dev->srCacheHash);
+		dev->srCacheHash = NULL;
+		dev->srCacheHashSize = 0;
+		dev->srCachePending = NULL;
+	}
+}
+
+/* Look up a cached chunk without touching the LRU order or the statistics */
+static yaffs_ChunkCache *yaffs_LookupChunkCache(const yaffs_Object *obj,
+						int chunkId)
+{
+	yaffs_Device *dev = obj->myDev;
+	yaffs_ChunkCache *cache;
+	struct ylist_head *bucket;
+	struct ylist_head *i;
+	int n;
+
+	if (yaffs_ChunkCacheIndexReady(dev)) {
+		bucket = &dev->srCacheHash[yaffs_ChunkCacheHash(dev, obj, chunkId)];
+		ylist_for_each(i, bucket) {
+			cache = ylist_entry(i, yaffs_ChunkCache, hashLink);
+			if (cache->object == obj && cache->chunkId == chunkId)
+				return cache;
+		}
+		return NULL;
+	}
+
+	for (n = 0; n < dev->nShortOpCaches; n++) {
+		if (dev->srCache[n].object == obj &&
+		    dev->srCache[n].chunkId == chunkId)
+			return &dev->srCache[n];
+	}
+
+	return NULL;
+}
+
 static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
@@ -4018,8 +4525,9 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 								 cache->data,
 								 cache->nBytes,
 								 1);
+				dev->cacheWriteBacks++;
 				cache->dirty = 0;
-				cache->object = NULL;
+				yaffs_ChunkCacheRelease(dev, cache);
 			}
 
 		} while (cache && chunkWritten > 0);
@@ -4083,6 +4591,37 @@ static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 	return NULL;
 }
 
+/* Grab using the LRU list.
+ * Walk from the cold end: freed entries are put there, so the first unlocked
+ * entry is either free, clean (just drop it) or dirty, in which case its
+ * object's dirty chunks are written out together, lowest chunk first.
+ */
+static yaffs_ChunkCache *yaffs_GrabChunkCacheLru(yaffs_Device *dev)
+{
+	yaffs_ChunkCache *cache = NULL;
+	struct ylist_head *i;
+
+	for (i = dev->srCacheLru.prev; i != &dev->srCacheLru; i = i->prev) {
+		cache = ylist_entry(i, yaffs_ChunkCache, lruLink);
+		if (!cache->locked)
+			break;
+		cache = NULL;
+	}
+
+	if (cache && cache->object) {
+		if (cache->dirty) {
+			yaffs_FlushFilesChunkCache(cache->object);
+			if (cache->dirty)
+				return NULL;
+		}
+		dev->cacheEvictions++;
+		yaffs_ChunkCacheRelease(dev, cache);
+	}
+
+	dev->srCachePending = cache;
+	return cache;
+}
+
 static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 {
 	yaffs_ChunkCache *cache;
@@ -4091,6 +4630,9 @@ static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 	int i;
 	int pushout;
 
+	if (yaffs_ChunkCacheIndexReady(dev))
+		return yaffs_GrabChunkCacheLru(dev);
+
 	if (dev->nShortOpCaches > 0) {
 		/* Try find a non-dirty one... */
 
@@ -4127,6 +4669,9 @@ static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 				cache = yaffs_GrabChunkCacheWorker(dev);
 			}
 
+			if (cache)
+				dev->cacheEvictions++;
+
 		}
 		return cache;
 	} else
@@ -4139,18 +4684,24 @@ static yaffs_ChunkCache *yaffs_FindChunkCache(const yaffs_Object *obj,
 					      int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
-	if (dev->nShortOpCaches > 0) {
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].object == obj &&
-			    dev->srCache[i].chunkId == chunkId) {
-				dev->cacheHits++;
+	yaffs_ChunkCache *cache;
 
-				return &dev->srCache[i];
-			}
-		}
+	if (dev->nShortOpCaches <= 0)
+		return NULL;
+
+	cache = yaffs_LookupChunkCache(obj, chunkId);
+	if (!cache) {
+		dev->cacheMisses++;
+		return NULL;
 	}
-	return NULL;
+
+	dev->cacheHits++;
+	if (dev->srCacheHash) {
+		ylist_del(&cache->lruLink);
+		ylist_add(&cache->lruLink, &dev->srCacheLru);
+	}
+
+	return cache;
 }
 
 /* Mark the chunk for the least recently used algorithym */
@@ -88,7 +88,7 @@
 
 /* */
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+#define YAFFS_MAX_SHORT_OP_CACHES	512
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
@@ -119,6 +119,8 @@ typedef struct {
 	int dirty;
 	int nBytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
+	struct ylist_head hashLink;	/* Chain in dev->srCacheHash */
+	struct ylist_head lruLink;	/* dev->srCacheLru, most recent first */
 #ifdef CONFIG_YAFFS_YAFFS2
 	__u8 *data;
 #else
@@ -385,8 +387,22 @@ typedef struct {
 	yaffs_Tnode *top;
 } yaffs_FileStructure;
 
+/* Hashed name index for large directories, built on first lookup.
+ * Children are chained on their dirHashLink, bucketed by name sum.
+ */
+typedef struct yaffs_DirIndexStruct {
+	struct ylist_head indexList;	/* device list, most recently used first */
+	struct yaffs_ObjectStruct *dir;
+	int nBuckets;			/* power of 2 */
+	int nEntries;
+	int bytes;			/* memory charged to the device */
+	int bucketsAlt;			/* buckets allocated with YMALLOC_ALT */
+	struct ylist_head *buckets;
+} yaffs_DirIndex;
+
 typedef struct {
 	struct ylist_head children;     /* list of child links */
+	yaffs_DirIndex *index;		/* name index, or NULL */
 } yaffs_DirectoryStructure;
 
 typedef struct {
@@ -441,6 +457,7 @@ struct yaffs_ObjectStruct {
 	/* also used for linking up the free list */
 	struct yaffs_ObjectStruct *parent;
 	struct ylist_head siblings;
+	struct ylist_head dirHashLink;	/* bucket in parent's name index */
 
 	/* Where's my object header in NAND? */
 	int hdrChunk;
@@ -532,6 +549,19 @@ typedef struct {
 	int maxLine;
 } yaffs_TempBuffer;
 
+#ifdef __KERNEL__
+/*--------------------- Lock statistics ----------------
+ *
+ * Per-lock acquisition counters reported through /proc/yaffs.
+ */
+
+typedef struct {
+	unsigned acquired;	/* Times the lock was taken */
+	unsigned contended;	/* Times the taker had to wait */
+	__u64 waitUs;		/* Total time spent waiting */
+} yaffs_LockStats;
+#endif
+
 /*----------------- Device ---------------------------------*/
 
 
@@ -640,13 +670,28 @@ struct yaffs_DeviceStruct {
 #ifdef __KERNEL__
 
 	struct semaphore sem;	/* Semaphore for waiting on erasure.*/
-	struct semaphore grossLock;	/* Gross locking semaphore */
+	struct rw_semaphore grossLock;	/* Gross lock. Taken shared by readpage */
+	struct mutex nandLock;	/* Serialises NAND reads by shared lock holders */
+	spinlock_t lockStatLock;	/* Protects the lock statistics */
+	yaffs_LockStats grossStats;	/* grossLock taken exclusive */
+	yaffs_LockStats sharedStats;	/* grossLock taken shared */
+	yaffs_LockStats nandStats;	/* nandLock */
 	struct rw_semaphore dirLock; /* Lock the directory structure */
 	__u8 *spareBuffer;	/* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
 
 				 */
 	void (*putSuperFunc) (struct super_block *sb);
+	struct task_struct *bgThread;	/* Background gc and checkpointing */
+	unsigned long lastActivity;	/* jiffies when the fs was last used */
+	unsigned long lastCheckpoint;	/* jiffies of the last runtime checkpoint */
+	unsigned nRuntimeCheckpoints;
+
+	/* Batched tag reads while mounting (mtdif2) */
+	__u8 *scanOobBuffer;	/* tags for every chunk in scanOobBlock */
+	int scanOobBlock;	/* block held in scanOobBuffer, or -1 */
+	unsigned nBatchedTagReads;
+	__u64 mountTimeUs;
         struct ylist_head searchContexts;
 
 #endif
@@ -729,6 +774,9 @@ struct yaffs_DeviceStruct {
 	int nGCCopies;
 	int garbageCollections;
 	int passiveGarbageCollections;
+	int backgroundGarbageCollections;
+	__u64 gcTimeForeground;	/* us spent in gc from the write path */
+	__u64 gcTimeBackground;	/* us spent in gc from the background */
 	int nRetriedWrites;
 	int nRetiredBlocks;
 	int eccFixed;
@@ -755,7 +803,19 @@ struct yaffs_DeviceStruct {
 	yaffs_ChunkCache *srCache;
 	int srLastUse;
 
+	/* Chunk cache index, built on first use. srCachePending is the entry
+	 * handed out by the last grab, which is hashed once the caller has
+	 * filled in its object and chunkId.
+	 */
+	struct ylist_head *srCacheHash;
+	int srCacheHashSize;
+	struct ylist_head srCacheLru;
+	yaffs_ChunkCache *srCachePending;
+
 	int cacheHits;
+	int cacheMisses;
+	int cacheEvictions;
+	int cacheWriteBacks;
 
 	/* Stuff for background deletion and unlinked files.*/
 	yaffs_Object *unlinkedDir;	/* Directory where unlinked and deleted files live. */
@@ -779,6 +839,21 @@ struct yaffs_DeviceStruct {
 	
 	/* Auto empty lost and found directory on mount */
 	int emptyLostAndFound;
+
+	/* Directory name index. dirIndexList must be initialised by the OS
+	 * layer, which must also call yaffs_DirIndexRemove() from its
+	 * removeObjectCallback.
+	 */
+	int dirIndexMaxBytes;		/* memory cap, 0 disables the index */
+	int dirIndexBytes;		/* memory currently in use */
+	struct ylist_head dirIndexList;	/* indexed directories, LRU order */
+	int nDirIndexBuilds;
+	int nDirIndexEvictions;
+
+	/* Name lookup statistics */
+	int nNameLookups;
+	__u64 nameLookupTimeUs;
+	__u32 nameLookupMaxUs;
 };
 
 typedef struct yaffs_DeviceStruct yaffs_Device;
@@ -848,6 +923,8 @@ int yaffs_GetAttributes(yaffs_Object *obj, struct iattr *attr);
 /* File operations */
 int yaffs_ReadDataFromFile(yaffs_Object *obj, __u8 *buffer, loff_t offset,
 				int nBytes);
+int yaffs_FindChunkRun(yaffs_Object *obj, int firstChunk, int nChunks,
+			int *nandChunk);
 int yaffs_WriteDataToFile(yaffs_Object *obj, const __u8 *buffer, loff_t offset,
 				int nBytes, int writeThrough);
 int yaffs_ResizeFile(yaffs_Object *obj, loff_t newSize);
@@ -859,6 +936,10 @@ int yaffs_FlushFile(yaffs_Object *obj, int updateTime, int dataSync);
 
 /* Flushing and checkpointing */
 void yaffs_FlushEntireDeviceCache(yaffs_Device *dev);
+void yaffs_ChunkCacheIndexFree(yaffs_Device *dev);
+
+/* Background garbage collection */
+int yaffs_BackgroundGarbageCollect(yaffs_Device *dev, int maxLive);
 
 int yaffs_CheckpointSave(yaffs_Device *dev);
 int yaffs_CheckpointRestore(yaffs_Device *dev);
@@ -867,6 +948,10 @@ int yaffs_CheckpointRestore(yaffs_Device *dev);
 yaffs_Object *yaffs_MknodDirectory(yaffs_Object *parent, const YCHAR *name,
 				__u32 mode, __u32 uid, __u32 gid);
 yaffs_Object *yaffs_FindObjectByName(yaffs_Object *theDir, const YCHAR *name);
+yaffs_Object *yaffs_FindObjectByNameIndexed(yaffs_Object *theDir,
+					const YCHAR *name);
+void yaffs_DirIndexRemove(yaffs_Object *obj);
+void yaffs_DirIndexFreeAll(yaffs_Device *dev);
 int yaffs_ApplyToDirectoryChildren(yaffs_Object *theDir,
 				   int (*fn) (yaffs_Object *));
 
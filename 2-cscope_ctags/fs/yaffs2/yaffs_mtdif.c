@@ -226,6 +226,9 @@ int nandmtd_EraseBlockInNAND(yaffs_Device *dev, int blockNumber)
 
 	sema_init(&dev->sem, 0);
 
+	if (dev->scanOobBlock == blockNumber)
+		dev->scanOobBlock = -1;
+
 	retval = mtd->erase(mtd, &ei);
 
 	if (retval == 0)
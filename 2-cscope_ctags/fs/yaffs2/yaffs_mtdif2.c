@@ -58,6 +58,9 @@ int nandmtd2_WriteChunkWithTagsToNAND(yaffs_Device *dev, int chunkInNAND,
 
 	addr  = ((loff_t) chunkInNAND) * dev->totalBytesPerChunk;
 
+	if (dev->scanOobBlock == chunkInNAND / dev->nChunksPerBlock)
+		dev->scanOobBlock = -1;
+
 	/* For yaffs2 writing there must be both data and tags.
 	 * If we're using inband tags, then the tags are stuffed into
 	 * the end of the data buffer.
@@ -98,6 +101,58 @@ int nandmtd2_WriteChunkWithTagsToNAND(yaffs_Device *dev, int chunkInNAND,
 		return YAFFS_FAIL;
 }
 
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
+/* While mounting, the scan reads the tags of every chunk in a block one
+ * after the other. If the OS layer has set up dev->scanOobBuffer, read the
+ * tags for the whole block in one read_oob call instead, and serve the
+ * following chunks from the buffer. The buffer is dropped as soon as
+ * anything writes or erases that block.
+ * Returns 0 and leaves the packed tags in dev->spareBuffer, or an error if
+ * the caller should do a normal single chunk read.
+ */
+static int nandmtd2_ReadBatchedTags(yaffs_Device *dev, int chunkInNAND,
+					int packed_tags_size)
+{
+	struct mtd_info *mtd = (struct mtd_info *)(dev->genericDevice);
+	struct mtd_oob_ops ops;
+	int block = chunkInNAND / dev->nChunksPerBlock;
+	int retval;
+
+	/* A lone read of a block's first chunk is the block state query, which
+	 * is done for every block before scanning starts. The scan itself
+	 * works backwards from the last chunk, so only start a batch there.
+	 */
+	if (block != dev->scanOobBlock &&
+	    (chunkInNAND % dev->nChunksPerBlock) == 0)
+		return -EAGAIN;
+
+	if (block != dev->scanOobBlock) {
+		ops.mode = MTD_OOB_AUTO;
+		ops.ooblen = mtd->oobavail * dev->nChunksPerBlock;
+		ops.len = 0;
+		ops.ooboffs = 0;
+		ops.datbuf = NULL;
+		ops.oobbuf = dev->scanOobBuffer;
+		retval = mtd->read_oob(mtd,
+			((loff_t) block) * dev->nChunksPerBlock *
+				dev->totalBytesPerChunk, &ops);
+		if (retval) {
+			dev->scanOobBlock = -1;
+			return retval;
+		}
+		dev->scanOobBlock = block;
+		dev->nBatchedTagReads++;
+	}
+
+	memcpy(dev->spareBuffer,
+		dev->scanOobBuffer +
+			(chunkInNAND % dev->nChunksPerBlock) * mtd->oobavail,
+		packed_tags_size);
+
+	return 0;
+}
+#endif
+
 int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 				       __u8 *data, yaffs_ExtendedTags *tags)
 {
@@ -136,6 +191,9 @@ int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 	if (dev->inbandTags || (data && !tags))
 		retval = mtd->read(mtd, addr, dev->totalBytesPerChunk,
 				&dummy, data);
+	else if (tags && !data && dev->scanOobBuffer &&
+		 nandmtd2_ReadBatchedTags(dev, chunkInNAND, packed_tags_size) == 0)
+		retval = 0;
 	else if (tags) {
 		ops.mode = MTD_OOB_AUTO;
 		ops.ooblen = packed_tags_size;
@@ -195,6 +253,9 @@ int nandmtd2_MarkNANDBlockBad(struct yaffs_DeviceStruct *dev, int blockNo)
 	T(YAFFS_TRACE_MTD,
 	  (TSTR("nandmtd2_MarkNANDBlockBad %d" TENDSTR), blockNo));
 
+	if (dev->scanOobBlock == blockNo)
+		dev->scanOobBlock = -1;
+
 	retval =
 	    mtd->block_markbad(mtd,
 			       blockNo * dev->nChunksPerBlock *